@@ -1,4 +1,5 @@
 #include "Astar_searcher.h"
+#include <scope_trace/scope_trace.hpp>
 
 using namespace std;
 using namespace Eigen;
@@ -210,6 +211,7 @@ double AstarPathFinder::getHeu(GridNodePtr node1, GridNodePtr node2)
 
 void AstarPathFinder::AstarGraphSearch(Vector3d start_pt, Vector3d end_pt)
 {   
+    SCOPE_TRACE_ZONE("A*");
     ros::Time time_1 = ros::Time::now();    
 
     //index of start_point and end_point
@@ -361,6 +363,7 @@ void AstarPathFinder::AstarGraphSearch(Vector3d start_pt, Vector3d end_pt)
 
 vector<Vector3d> AstarPathFinder::getPath() 
 {   
+    SCOPE_TRACE_FUNCTION();
     vector<Vector3d> path;
     vector<GridNodePtr> gridPath;
     /*
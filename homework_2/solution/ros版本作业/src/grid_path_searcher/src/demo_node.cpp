@@ -17,6 +17,7 @@
 #include "Astar_searcher.h"
 #include "JPS_searcher.h"
 #include "backward.hpp"
+#include <scope_trace/scope_trace.hpp>
 
 using namespace std;
 using namespace Eigen;
@@ -107,6 +108,7 @@ void rcvPointCloudCallBack(const sensor_msgs::PointCloud2 & pointcloud_map)
 
 void pathFinding(const Vector3d start_pt, const Vector3d target_pt)
 {
+    SCOPE_TRACE_FUNCTION();
     //Call A* to search for a path
     _astar_path_finder->AstarGraphSearch(start_pt, target_pt);
 
@@ -127,8 +129,11 @@ void pathFinding(const Vector3d start_pt, const Vector3d target_pt)
 #define _use_jps 0
 #if _use_jps
     {
-        //Call JPS to search for a path
-        _jps_path_finder -> JPSGraphSearch(start_pt, target_pt);
+        //Call JPS to search for a path, traced here since read_only stays untouched
+        {
+            SCOPE_TRACE_ZONE("JPS");
+            _jps_path_finder -> JPSGraphSearch(start_pt, target_pt);
+        }
 
         //Retrieve the path
         auto grid_path     = _jps_path_finder->getPath();
@@ -167,6 +172,12 @@ int main(int argc, char** argv)
     nh.param("planning/start_y",  _start_pt(1),  0.0);
     nh.param("planning/start_z",  _start_pt(2),  0.0);
 
+    bool trace_enable;
+    string trace_output;
+    nh.param("trace/enable",      trace_enable, false);
+    nh.param("trace/output",      trace_output, string("/tmp/demo_node_trace.json"));
+    scope_trace::setEnabled(trace_enable);
+
     _map_lower << - _x_size/2.0, - _y_size/2.0,     0.0;
     _map_upper << + _x_size/2.0, + _y_size/2.0, _z_size;
     
@@ -191,6 +202,9 @@ int main(int argc, char** argv)
         rate.sleep();
     }
 
+    if(trace_enable && scope_trace::dump(trace_output))
+        ROS_INFO("[node] trace written to %s", trace_output.c_str());
+
     delete _astar_path_finder;
     delete _jps_path_finder;
     return 0;
@@ -0,0 +1,204 @@
+/*
+Copyright (C) 2022 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#ifndef _DEPTH_SENSOR_H
+#define _DEPTH_SENSOR_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Eigen/Eigen>
+#include <math.h>
+#include <cfloat>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace map_gen
+{
+
+struct DepthSensorParams
+{
+   std::string model; // "camera": pinhole image, "lidar": rings of evenly spaced beams
+   int width, height; // rays per row and per column
+   double h_fov, v_fov; // deg
+   double max_range;
+   bool emit_misses; // rays that hit nothing come back at twice max_range, a mapper then only clears along them
+};
+
+/* Simulated depth camera / LiDAR over a generated map. The map cloud is voxelized once, every scan then
+   marches its rays through the voxels in parallel and returns the first occupied voxel of each in the
+   world frame. The sensor frame is x forward, y left, z up. */
+class DepthSensor
+{
+public:
+   void setParams(const DepthSensorParams &param)
+   {
+      param_ = param;
+      double h_fov = param.h_fov * M_PI / 180.0, v_fov = param.v_fov * M_PI / 180.0;
+      rays_.resize(param.width * param.height);
+      for (int v = 0; v < param.height; ++v)
+         for (int u = 0; u < param.width; ++u)
+         {
+            Eigen::Vector3d &dir = rays_[v * param.width + u];
+            double su = (u + 0.5) / param.width, sv = (v + 0.5) / param.height;
+            if (param.model == "lidar")
+            {
+               double azimuth = h_fov / 2 - su * h_fov, elevation = v_fov / 2 - sv * v_fov;
+               dir = Eigen::Vector3d(cos(elevation) * cos(azimuth), cos(elevation) * sin(azimuth), sin(elevation));
+            }
+            else
+               dir = Eigen::Vector3d(1.0, (1.0 - 2.0 * su) * tan(h_fov / 2), (1.0 - 2.0 * sv) * tan(v_fov / 2)).normalized();
+         }
+   }
+
+   void setWorld(const pcl::PointCloud<pcl::PointXYZ> &cloud, double resolution)
+   {
+      resolution_ = resolution;
+      resolution_inv_ = 1.0 / resolution;
+      Eigen::Vector3d lo = Eigen::Vector3d::Constant(DBL_MAX), hi = Eigen::Vector3d::Constant(-DBL_MAX);
+      for (const auto &pt : cloud.points)
+      {
+         Eigen::Vector3d p(pt.x, pt.y, pt.z);
+         lo = lo.cwiseMin(p);
+         hi = hi.cwiseMax(p);
+      }
+      if (cloud.points.empty())
+         lo = hi = Eigen::Vector3d::Zero();
+      // on the lattice of the generators, so every voxel holds whole map voxels
+      origin_ = (lo * resolution_inv_).array().floor().matrix() * resolution;
+      grid_size_ = ((hi - origin_) * resolution_inv_).array().floor().cast<int>() + 1;
+      occ_.assign((size_t(grid_size_(0)) * grid_size_(1) * grid_size_(2) + 63) >> 6, 0);
+      for (const auto &pt : cloud.points)
+      {
+         Eigen::Vector3i id = ((Eigen::Vector3d(pt.x, pt.y, pt.z) - origin_) * resolution_inv_).array().floor().cast<int>();
+         size_t addr = address(id.cwiseMin(grid_size_ - Eigen::Vector3i::Ones()));
+         occ_[addr >> 6] |= uint64_t(1) << (addr & 63);
+      }
+   }
+
+   size_t getRayNum() const { return rays_.size(); }
+
+   // one scan from the sensor at pos with orientation rot, world frame points, misses included if emit_misses
+   void scan(const Eigen::Vector3d &pos, const Eigen::Matrix3d &rot, std::vector<Eigen::Vector3d> &points) const
+   {
+      int ray_num = rays_.size();
+      std::vector<Eigen::Vector3d> ends(ray_num);
+      std::vector<uint8_t> has_end(ray_num);
+#pragma omp parallel for schedule(dynamic, 256)
+      for (int i = 0; i < ray_num; ++i)
+      {
+         Eigen::Vector3d dir = rot * rays_[i];
+         double t;
+         has_end[i] = true;
+         if (castRay(pos, dir, t))
+            ends[i] = pos + dir * t;
+         else if (param_.emit_misses)
+            ends[i] = pos + dir * (2.0 * param_.max_range);
+         else
+            has_end[i] = false;
+      }
+      points.clear();
+      for (int i = 0; i < ray_num; ++i)
+         if (has_end[i])
+            points.push_back(ends[i]);
+   }
+
+private:
+   DepthSensorParams param_;
+   std::vector<Eigen::Vector3d> rays_; // sensor frame, unit length
+
+   double resolution_, resolution_inv_;
+   Eigen::Vector3d origin_;
+   Eigen::Vector3i grid_size_;
+   std::vector<uint64_t> occ_;
+
+   size_t address(const Eigen::Vector3i &id) const
+   {
+      return (size_t(id(0)) * grid_size_(1) + id(1)) * grid_size_(2) + id(2);
+   }
+
+   // Amanatides-Woo voxel walk from where the ray enters the voxelized box, t is the range to the
+   // face of the first occupied voxel, nudged inside it so the hit falls in that voxel
+   bool castRay(const Eigen::Vector3d &pos, const Eigen::Vector3d &dir, double &t) const
+   {
+      Eigen::Vector3d start = (pos - origin_) * resolution_inv_;
+      double t_min = 0.0, t_max = param_.max_range * resolution_inv_;
+      for (int i = 0; i < 3; ++i)
+      {
+         if (fabs(dir(i)) < 1e-12)
+         {
+            if (start(i) < 0.0 || start(i) >= grid_size_(i))
+               return false;
+            continue;
+         }
+         double t0 = -start(i) / dir(i), t1 = (grid_size_(i) - start(i)) / dir(i);
+         if (t0 > t1)
+            std::swap(t0, t1);
+         t_min = std::max(t_min, t0);
+         t_max = std::min(t_max, t1);
+      }
+      if (t_min >= t_max)
+         return false;
+
+      // walk with the linear address, one branch picks the axis whose boundary comes first
+      Eigen::Vector3d p = start + dir * t_min;
+      int id[3], step[3], bound[3];
+      long addr = 0, addr_step[3];
+      const long stride[3] = {long(grid_size_(1)) * grid_size_(2), grid_size_(2), 1};
+      double t_next[3], t_delta[3];
+      for (int i = 0; i < 3; ++i)
+      {
+         id[i] = std::min(std::max(int(floor(p(i))), 0), grid_size_(i) - 1);
+         step[i] = dir(i) > 0 ? 1 : -1;
+         bound[i] = dir(i) > 0 ? grid_size_(i) : -1;
+         addr += id[i] * stride[i];
+         addr_step[i] = step[i] * stride[i];
+         if (fabs(dir(i)) < 1e-12)
+            t_next[i] = t_delta[i] = DBL_MAX;
+         else
+         {
+            t_delta[i] = 1.0 / fabs(dir(i));
+            t_next[i] = t_min + ((dir(i) > 0 ? id[i] + 1 : id[i]) - p(i)) / dir(i);
+         }
+      }
+      double t_cur = t_min;
+      while (t_cur < t_max)
+      {
+         if ((occ_[addr >> 6] >> (addr & 63)) & 1)
+         {
+            t = (t_cur + 1e-3) * resolution_;
+            return true;
+         }
+         int axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+         t_cur = t_next[axis];
+         t_next[axis] += t_delta[axis];
+         id[axis] += step[axis];
+         addr += addr_step[axis];
+         if (id[axis] == bound[axis])
+            return false;
+      }
+      return false;
+   }
+};
+
+} // namespace map_gen
+
+#endif
@@ -0,0 +1,292 @@
+/*
+Copyright (C) 2021 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#ifndef _RANDOM_FOREST_H
+#define _RANDOM_FOREST_H
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <Eigen/Eigen>
+#include <math.h>
+#include <random>
+#include <vector>
+
+namespace map_gen
+{
+
+struct RandomForestParams
+{
+   double x_size, y_size;
+   double init_x, init_y;
+   double resolution;
+   int obs_num, cir_num;
+   double w_l, w_h, h_l, h_h;
+   double w_c_l, w_c_h;
+};
+
+// pillars and rings, the same seed always gives the same forest
+inline void generateRandomForest(const RandomForestParams &param, unsigned int seed, pcl::PointCloud<pcl::PointXYZ> &cloudMap)
+{
+   using namespace std;
+   using namespace Eigen;
+
+   default_random_engine eng(seed);
+   double _x_size = param.x_size, _y_size = param.y_size, _init_x = param.init_x, _init_y = param.init_y;
+   double _x_l = -_x_size / 2.0, _x_h = +_x_size / 2.0, _y_l = -_y_size / 2.0, _y_h = +_y_size / 2.0;
+   double _w_l = param.w_l, _w_h = param.w_h, _h_l = param.h_l, _h_h = param.h_h, _w_c_l = param.w_c_l, _w_c_h = param.w_c_h;
+   double _resolution = param.resolution;
+   int _obs_num = param.obs_num, _cir_num = param.cir_num;
+
+   uniform_real_distribution<double> rand_theta = uniform_real_distribution<double>(-M_PI, M_PI);
+
+   uniform_real_distribution<double> rand_x = uniform_real_distribution<double>(_x_l, _x_h);
+   uniform_real_distribution<double> rand_y = uniform_real_distribution<double>(_y_l, _y_h);
+   uniform_real_distribution<double> rand_w = uniform_real_distribution<double>(_w_l, _w_h);
+   uniform_real_distribution<double> rand_h = uniform_real_distribution<double>(_h_l, _h_h);
+
+   uniform_real_distribution<double> rand_x_circle = uniform_real_distribution<double>(_x_l + 1.0, _x_h - 1.0);
+   uniform_real_distribution<double> rand_y_circle = uniform_real_distribution<double>(_y_l + 1.0, _y_h - 1.0);
+   uniform_real_distribution<double> rand_r_circle = uniform_real_distribution<double>(_w_c_l, _w_c_h);
+
+   uniform_real_distribution<double> rand_roll = uniform_real_distribution<double>(-M_PI, +M_PI);
+   uniform_real_distribution<double> rand_pitch = uniform_real_distribution<double>(+M_PI / 4.0, +M_PI / 2.0);
+   uniform_real_distribution<double> rand_yaw = uniform_real_distribution<double>(+M_PI / 4.0, +M_PI / 2.0);
+   uniform_real_distribution<double> rand_ellipse_c = uniform_real_distribution<double>(0.5, 2.0);
+   uniform_real_distribution<double> rand_num = uniform_real_distribution<double>(0.0, 1.0);
+
+   pcl::PointXYZ pt_random;
+
+   int base2(2), base3(3), base4(4); //Halton base
+   // every circle samples its ellipse at the same angles
+   vector<double> cos_theta, sin_theta;
+   for (double theta = -M_PI; theta < M_PI; theta += 0.025)
+   {
+      cos_theta.push_back(cos(theta));
+      sin_theta.push_back(sin(theta));
+   }
+   // firstly, we put some circles
+   for (int i = 0; i < _cir_num; i++)
+   {
+      double x0, y0, z0, R;
+
+      // x0 = rand_x_circle(eng);
+      // y0 = rand_y_circle(eng);
+      z0 = rand_h(eng);
+
+      //Halton sequence for x(0, 1)
+      double f = 1;
+      x0 = 0;
+      int ii = i;
+      while (ii > 0)
+      {
+         f = f / base2;
+         x0 = x0 + f * (ii % base2);
+         ii = floor(ii / base2);
+      }
+      x0 *= _x_size;
+      x0 -= _x_size / 2;
+
+      //Halton sequence for y(0, 1)
+      f = 1;
+      y0 = 0;
+      ii = i;
+      while (ii > 0)
+      {
+         f = f / base3;
+         y0 = y0 + f * (ii % base3);
+         ii = floor(ii / base3);
+      }
+      y0 *= _y_size;
+      y0 -= _y_size / 2;
+
+      R = rand_r_circle(eng);
+
+      if (sqrt(pow(x0 - _init_x, 2) + pow(y0 - _init_y, 2)) < 1.5)
+         continue;
+
+      double a, b;
+      a = rand_ellipse_c(eng);
+      b = rand_ellipse_c(eng);
+
+      // Define a random 3d rotation matrix
+      Matrix3d Rot;
+      double roll, pitch, yaw;
+      double alpha, beta, gama;
+      roll = rand_roll(eng);   // alpha
+      pitch = rand_pitch(eng); // beta
+      yaw = rand_yaw(eng);     // gama
+
+      alpha = roll;
+      beta = pitch;
+      gama = yaw;
+
+      double p = rand_num(eng);
+      if (p < 0.5)
+      {
+         beta = M_PI / 2.0;
+         gama = M_PI / 2.0;
+      }
+
+      Rot << cos(alpha) * cos(gama) - cos(beta) * sin(alpha) * sin(gama), -cos(beta) * cos(gama) * sin(alpha) - cos(alpha) * sin(gama), sin(alpha) * sin(beta),
+          cos(gama) * sin(alpha) + cos(alpha) * cos(beta) * sin(gama), cos(alpha) * cos(beta) * cos(gama) - sin(alpha) * sin(gama), -cos(alpha) * sin(beta),
+          sin(beta) * sin(gama), cos(gama) * sin(beta), cos(beta);
+
+      // the ellipse lies in z = 0, only the first two columns of Rot move it
+      for (size_t k = 0; k < cos_theta.size(); ++k)
+      {
+         double x = a * cos_theta[k] * R, y = b * sin_theta[k] * R;
+         pt_random.x = (Rot(0, 0) * x + Rot(0, 1) * y) + x0 + 0.001;
+         pt_random.y = (Rot(1, 0) * x + Rot(1, 1) * y) + y0 + 0.001;
+         pt_random.z = (Rot(2, 0) * x + Rot(2, 1) * y) + z0 + 0.001 - 1;
+
+         if (pt_random.z >= 0.0)
+            cloudMap.points.push_back(pt_random);
+      }
+   }
+
+   // pillars keep 1 m away from the circles, measured at their mid height, so only circle points within 1 m
+   // of that height matter. They are bucketed in a 1 m grid over x-y, one pillar then checks 3x3 cells
+   const float clearance = 1.0f, check_z = (_h_l + _h_h) / 2.0;
+   const double grid_x0 = _x_l - clearance, grid_y0 = _y_l - clearance;
+   const int grid_x = ceil(_x_size / clearance) + 2, grid_y = ceil(_y_size / clearance) + 2;
+   vector<int> cell_start(grid_x * grid_y + 1, 0), circle_cell(cloudMap.points.size(), -1);
+   for (size_t i = 0; i < cloudMap.points.size(); ++i)
+   {
+      const pcl::PointXYZ &pt = cloudMap.points[i];
+      int cx = floor((pt.x - grid_x0) / clearance), cy = floor((pt.y - grid_y0) / clearance);
+      if (fabs(pt.z - check_z) >= clearance || cx < 0 || cx >= grid_x || cy < 0 || cy >= grid_y)
+         continue;
+      circle_cell[i] = cx * grid_y + cy;
+      ++cell_start[circle_cell[i] + 1];
+   }
+   for (size_t c = 1; c < cell_start.size(); ++c)
+      cell_start[c] += cell_start[c - 1];
+   vector<pcl::PointXYZ, Eigen::aligned_allocator<pcl::PointXYZ>> circle_pts(cell_start.back());
+   vector<int> cell_fill(cell_start.begin(), cell_start.end() - 1);
+   for (size_t i = 0; i < cloudMap.points.size(); ++i)
+      if (circle_cell[i] >= 0)
+         circle_pts[cell_fill[circle_cell[i]]++] = cloudMap.points[i];
+   auto near_circle = [&](const pcl::PointXYZ &q)
+   {
+      int cx = floor((q.x - grid_x0) / clearance), cy = floor((q.y - grid_y0) / clearance);
+      for (int x = max(cx - 1, 0); x <= min(cx + 1, grid_x - 1); ++x)
+         for (int y = max(cy - 1, 0); y <= min(cy + 1, grid_y - 1); ++y)
+            for (int k = cell_start[x * grid_y + y]; k < cell_start[x * grid_y + y + 1]; ++k)
+            {
+               const pcl::PointXYZ &p = circle_pts[k];
+               float dx = p.x - q.x, dy = p.y - q.y, dz = p.z - q.z;
+               if (dx * dx + dy * dy + dz * dz < clearance * clearance)
+                  return true;
+            }
+      return false;
+   };
+
+   // then, we put some pilar
+   for (int i = 0; i < _obs_num; i++)
+   {
+      double x, y, w, h;
+      // x    = rand_x(eng);
+      // y    = rand_y(eng);
+      w = rand_w(eng);
+
+      //Halton sequence for x(0, 1)
+      double f = 1;
+      x = 0;
+      int ii = i;
+      while (ii > 0)
+      {
+         f = f / base2;
+         x = x + f * (ii % base2);
+         ii = floor(ii / base2);
+      }
+      x *= _x_size;
+      x -= _x_size / 2;
+
+      //Halton sequence for y(0, 1)
+      f = 1;
+      y = 0;
+      ii = i;
+      while (ii > 0)
+      {
+         f = f / base3;
+         y = y + f * (ii % base3);
+         ii = floor(ii / base3);
+      }
+      y *= _y_size;
+      y -= _y_size / 2;
+
+      double d_theta = rand_theta(eng);
+
+      if (sqrt(pow(x - _init_x, 2) + pow(y - _init_y, 2)) < 2.0)
+         continue;
+
+      if (near_circle(pcl::PointXYZ(x, y, check_z)))
+         continue;
+
+      x = floor(x / _resolution) * _resolution + _resolution / 2.0;
+      y = floor(y / _resolution) * _resolution + _resolution / 2.0;
+
+      int widNum = ceil(w / _resolution);
+      int halfWidNum = widNum / 2.0;
+      for (int r = -halfWidNum; r < halfWidNum; r++)
+      {
+         for (int s = -halfWidNum; s < halfWidNum; s++)
+         {
+            // make pilars hollow
+            if (r > -halfWidNum + 2 && r < (halfWidNum - 3))
+            {
+               if (s > -halfWidNum + 2 && s < (halfWidNum - 3))
+               {
+                  continue;
+               }
+            }
+            // rotate
+            double th = atan2((double)s, (double)r);
+            int len = sqrt(s * s + r * r);
+            th += d_theta;
+            int rr = cos(th) * len;
+            int ss = sin(th) * len;
+
+            h = rand_h(eng);
+            int heiNum = 2.0 * ceil(h / _resolution);
+            // write the column in place
+            size_t col = cloudMap.points.size();
+            cloudMap.points.resize(col + max(heiNum, 0));
+            pt_random.x = x + (rr + 0.0) * _resolution + 0.001;
+            pt_random.y = y + (ss + 0.0) * _resolution + 0.001;
+            for (int t = 0; t < heiNum; t++)
+            {
+               pt_random.z = (t + 0.0) * _resolution * 0.5 - 1.0 + 0.001;
+               cloudMap.points[col + t] = pt_random;
+            }
+         }
+      }
+   }
+
+   cloudMap.width = cloudMap.points.size();
+   cloudMap.height = 1;
+   cloudMap.is_dense = true;
+}
+
+
+} // namespace map_gen
+
+#endif
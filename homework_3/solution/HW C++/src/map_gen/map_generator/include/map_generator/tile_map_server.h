@@ -0,0 +1,241 @@
+/*
+Copyright (C) 2022 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#ifndef _TILE_MAP_SERVER_H
+#define _TILE_MAP_SERVER_H
+
+#include "self_msgs_and_srvs/GetMapTiles.h"
+#include "self_msgs_and_srvs/MapTileArray.h"
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl_conversions/pcl_conversions.h>
+
+#include <Eigen/Eigen>
+#include <math.h>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace map_gen
+{
+
+/* Serves a global point cloud map as cubic tiles instead of one full cloud. Clients ask /get_map_tiles
+   for the tiles overlapping their box at the resolution they use, and afterwards only for the tiles changed
+   since the version they hold. Every setMap that changes some tiles bumps the map version and publishes
+   just those tiles on ~map_tile_updates. */
+class TileMapServer
+{
+public:
+   TileMapServer(const ros::NodeHandle &nh) : nh_(nh), version_(0)
+   {
+      nh_.param("tile_server/tile_size", tile_size_, 5.0);
+      nh_.param("tile_server/frame_id", frame_id_, std::string("map"));
+      update_pub_ = nh_.advertise<self_msgs_and_srvs::MapTileArray>("map_tile_updates", 10);
+      tile_service_ = nh_.advertiseService("/get_map_tiles", &TileMapServer::serveTiles, this);
+   }
+
+   void setMap(const pcl::PointCloud<pcl::PointXYZ> &cloud)
+   {
+      std::unordered_map<int64_t, Tile> tiles;
+      for (const auto &pt : cloud.points)
+      {
+         Eigen::Vector3i idx = tileIndex(pt);
+         Tile &tile = tiles[tileKey(idx)];
+         tile.index = idx;
+         tile.points.push_back(pt);
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      // a tile keeps its version as long as its points stay the same, tiles gone from the map
+      // stay as empty ones so clients holding them learn they were cleared
+      std::vector<int64_t> changed;
+      for (auto &it : tiles)
+      {
+         auto old = tiles_.find(it.first);
+         if (old == tiles_.end() || !samePoints(old->second.points, it.second.points))
+            changed.push_back(it.first);
+         else
+            it.second.version = old->second.version;
+      }
+      for (auto &it : tiles_)
+         if (tiles.find(it.first) == tiles.end())
+         {
+            if (!it.second.points.empty())
+               changed.push_back(it.first);
+            Tile &tile = tiles[it.first];
+            tile.index = it.second.index;
+            tile.version = it.second.version;
+         }
+      tiles_.swap(tiles);
+      if (changed.empty())
+         return;
+
+      ++version_;
+      self_msgs_and_srvs::MapTileArray update;
+      initTileArray(0.0, update);
+      for (int64_t key : changed)
+      {
+         Tile &tile = tiles_[key];
+         tile.version = version_;
+         update.tiles.emplace_back();
+         tileToMsg(tile, Eigen::Vector3d::Zero(), 0.0, update.tiles.back());
+      }
+      update_pub_.publish(update);
+      ROS_INFO_STREAM("[TileMapServer] map version " << version_ << ", " << changed.size() << " of " << tiles_.size() << " tiles changed");
+   }
+
+   uint32_t getVersion() const { return version_; }
+
+   // points are thinned on the voxel lattice of resolution anchored at origin, the one of the client's grid
+   void getTiles(const Eigen::Vector3d &lo, const Eigen::Vector3d &hi, const Eigen::Vector3d &origin, double resolution,
+                 uint32_t since_version, self_msgs_and_srvs::MapTileArray &tiles)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      initTileArray(resolution, tiles);
+      Eigen::Vector3i lo_idx = tileIndex(lo), hi_idx = tileIndex(hi);
+      // walk the smaller of the box and the stored tiles
+      if (int64_t(hi_idx(0) - lo_idx(0) + 1) * (hi_idx(1) - lo_idx(1) + 1) * (hi_idx(2) - lo_idx(2) + 1) < (int64_t)tiles_.size())
+      {
+         Eigen::Vector3i idx;
+         for (idx(0) = lo_idx(0); idx(0) <= hi_idx(0); ++idx(0))
+            for (idx(1) = lo_idx(1); idx(1) <= hi_idx(1); ++idx(1))
+               for (idx(2) = lo_idx(2); idx(2) <= hi_idx(2); ++idx(2))
+               {
+                  auto it = tiles_.find(tileKey(idx));
+                  if (it != tiles_.end() && it->second.version > since_version)
+                  {
+                     tiles.tiles.emplace_back();
+                     tileToMsg(it->second, origin, resolution, tiles.tiles.back());
+                  }
+               }
+      }
+      else
+      {
+         for (const auto &it : tiles_)
+         {
+            const Eigen::Vector3i &idx = it.second.index;
+            if (it.second.version > since_version && (idx.array() >= lo_idx.array()).all() && (idx.array() <= hi_idx.array()).all())
+            {
+               tiles.tiles.emplace_back();
+               tileToMsg(it.second, origin, resolution, tiles.tiles.back());
+            }
+         }
+      }
+   }
+
+private:
+   struct Tile
+   {
+      Eigen::Vector3i index;
+      uint32_t version = 0;
+      std::vector<pcl::PointXYZ, Eigen::aligned_allocator<pcl::PointXYZ>> points;
+   };
+
+   ros::NodeHandle nh_;
+   ros::Publisher update_pub_;
+   ros::ServiceServer tile_service_;
+   double tile_size_;
+   std::string frame_id_;
+
+   std::mutex mutex_;
+   uint32_t version_;
+   std::unordered_map<int64_t, Tile> tiles_;
+
+   Eigen::Vector3i tileIndex(const pcl::PointXYZ &pt) const
+   {
+      return Eigen::Vector3i(floor(pt.x / tile_size_), floor(pt.y / tile_size_), floor(pt.z / tile_size_));
+   }
+   Eigen::Vector3i tileIndex(const Eigen::Vector3d &pos) const
+   {
+      return (pos / tile_size_).array().floor().cast<int>();
+   }
+   // 21 bits per axis
+   static int64_t tileKey(const Eigen::Vector3i &idx)
+   {
+      const int64_t mask = (int64_t(1) << 21) - 1;
+      return ((int64_t(idx(0)) & mask) << 42) | ((int64_t(idx(1)) & mask) << 21) | (int64_t(idx(2)) & mask);
+   }
+
+   template <class Points>
+   static bool samePoints(const Points &a, const Points &b)
+   {
+      if (a.size() != b.size())
+         return false;
+      for (size_t i = 0; i < a.size(); ++i)
+         if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].z != b[i].z)
+            return false;
+      return true;
+   }
+
+   void initTileArray(double resolution, self_msgs_and_srvs::MapTileArray &tiles) const
+   {
+      tiles.header.stamp = ros::Time::now();
+      tiles.header.frame_id = frame_id_;
+      tiles.version = version_;
+      tiles.tile_size = tile_size_;
+      tiles.resolution = resolution;
+      tiles.tiles.clear();
+   }
+
+   // keeps the first point falling in each voxel of resolution from origin, so every point still lies in a voxel
+   // it occupied
+   void tileToMsg(const Tile &tile, const Eigen::Vector3d &origin, double resolution, self_msgs_and_srvs::MapTile &msg) const
+   {
+      msg.ix = tile.index(0);
+      msg.iy = tile.index(1);
+      msg.iz = tile.index(2);
+      msg.version = tile.version;
+      pcl::PointCloud<pcl::PointXYZ> cloud;
+      if (resolution <= 0.0)
+         cloud.points.assign(tile.points.begin(), tile.points.end());
+      else
+      {
+         std::unordered_set<int64_t> voxels;
+         voxels.reserve(tile.points.size());
+         for (const auto &pt : tile.points)
+         {
+            Eigen::Vector3i v(floor((pt.x - origin(0)) / resolution), floor((pt.y - origin(1)) / resolution),
+                              floor((pt.z - origin(2)) / resolution));
+            if (voxels.insert(tileKey(v)).second)
+               cloud.points.push_back(pt);
+         }
+      }
+      cloud.width = cloud.points.size();
+      cloud.height = 1;
+      cloud.is_dense = true;
+      pcl::toROSMsg(cloud, msg.cloud);
+      msg.cloud.header.frame_id = frame_id_;
+   }
+
+   bool serveTiles(self_msgs_and_srvs::GetMapTiles::Request &req, self_msgs_and_srvs::GetMapTiles::Response &res)
+   {
+      getTiles(Eigen::Vector3d(req.min.x, req.min.y, req.min.z), Eigen::Vector3d(req.max.x, req.max.y, req.max.z),
+               Eigen::Vector3d(req.origin.x, req.origin.y, req.origin.z), req.resolution, req.since_version, res.tiles);
+      return true;
+   }
+};
+
+} // namespace map_gen
+
+#endif
@@ -23,8 +23,15 @@ public:
   PerlinNoise(unsigned int seed);
   // Get a noise value, for 2D images z can have any value
   double noise(double x, double y, double z);
+  // Noise of the points (x, y, z[i]) for i < n, one column of a volume. The hashing and the x and y
+  // dependent part of each lattice cell are done once per cell, the values equal noise() bit for bit.
+  void noiseColumn(double x, double y, const double* z, int n, double* out);
 
 private:
+  // gradients of grad() as (d/dx, d/dy, d/dz) for the 16 hash values
+  double gradTable[16][3];
+
+  void initGradTable();
   double fade(double t);
   double lerp(double t, double a, double b);
   double grad(int hash, double x, double y, double z);
@@ -1,6 +1,7 @@
 #include "maps.hpp"
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <random>
 #include <vector>
@@ -117,49 +118,59 @@ Maps::perlin3D()
 
   PerlinNoise noise(info.seed);
 
-  std::vector<double>* v = new std::vector<double>;
-  v->reserve(info.cloud->width);
-  for (int i = 0; i < info.sizeX; ++i)
+  // z coordinates of a column per octave, shared by all columns
+  std::vector<std::vector<double> > zs(fractal);
+  for (int it = 1; it <= fractal; ++it)
   {
-    for (int j = 0; j < info.sizeY; ++j)
+    int dfv = pow(2, it);
+    zs[it - 1].resize(info.sizeZ);
+    for (int k = 0; k < info.sizeZ; ++k)
+      zs[it - 1][k] = dfv * k * complexity;
+  }
+
+  // noise of every voxel, evaluated once column by column, x slabs in
+  // parallel
+  std::vector<double> v(info.cloud->width);
+#pragma omp parallel
+  {
+    std::vector<double> column(info.sizeZ);
+#pragma omp for schedule(dynamic)
+    for (int i = 0; i < info.sizeX; ++i)
     {
-      for (int k = 0; k < info.sizeZ; ++k)
+      for (int j = 0; j < info.sizeY; ++j)
       {
-        double tnoise = 0;
+        double* tnoise = &v[((size_t)i * info.sizeY + j) * info.sizeZ];
+        std::fill(tnoise, tnoise + info.sizeZ, 0.0);
         for (int it = 1; it <= fractal; ++it)
         {
           int    dfv = pow(2, it);
           double ta  = attenuation / it;
-          tnoise += ta * noise.noise(dfv * i * complexity,
-                                     dfv * j * complexity,
-                                     dfv * k * complexity);
+          noise.noiseColumn(dfv * i * complexity, dfv * j * complexity,
+                            zs[it - 1].data(), info.sizeZ, column.data());
+          for (int k = 0; k < info.sizeZ; ++k)
+            tnoise[k] += ta * column[k];
         }
-        v->push_back(tnoise);
       }
     }
   }
-  std::sort(v->begin(), v->end());
-  int    tpos = info.cloud->width * (1 - fill);
-  double tmp  = v->at(tpos);
+
+  // the fill quantile only needs a selection, not a full sort
+  std::vector<double> sorted(v);
+  int                 tpos = info.cloud->width * (1 - fill);
+  std::nth_element(sorted.begin(), sorted.begin() + tpos, sorted.end());
+  double tmp = sorted.at(tpos);
+  std::vector<double>().swap(sorted);
   ROS_INFO("threshold: %lf", tmp);
 
-  int pos = 0;
+  int    pos = 0;
+  size_t idx = 0;
   for (int i = 0; i < info.sizeX; ++i)
   {
     for (int j = 0; j < info.sizeY; ++j)
     {
-      for (int k = 0; k < info.sizeZ; ++k)
+      for (int k = 0; k < info.sizeZ; ++k, ++idx)
       {
-        double tnoise = 0;
-        for (int it = 1; it <= fractal; ++it)
-        {
-          int    dfv = pow(2, it);
-          double ta  = attenuation / it;
-          tnoise += ta * noise.noise(dfv * i * complexity,
-                                     dfv * j * complexity,
-                                     dfv * k * complexity);
-        }
-        if (tnoise > tmp)
+        if (v[idx] > tmp)
         {
           info.cloud->points[pos].x =
             i / info.scale - info.sizeX / (2 * info.scale);
@@ -713,6 +724,70 @@ Maps::generate(int type)
       Maze3DGen();
       break;
   }
+
+  bool optimize;
+  info.nh_private->param("optimize_map", optimize, false);
+  if (optimize)
+    optimizeMap();
+}
+
+void
+Maps::optimizeMap()
+{
+  // drop the points whose 26 neighbours on the voxel grid are all occupied,
+  // they are hidden inside obstacles
+  std::vector<pcl::PointXYZ, Eigen::aligned_allocator<pcl::PointXYZ> >&
+    points = info.cloud->points;
+  if (points.empty())
+    return;
+
+  Eigen::Vector3f lo(points[0].x, points[0].y, points[0].z), hi = lo;
+  for (size_t i = 1; i < points.size(); ++i)
+  {
+    Eigen::Vector3f pt(points[i].x, points[i].y, points[i].z);
+    lo = lo.cwiseMin(pt);
+    hi = hi.cwiseMax(pt);
+  }
+  // one empty voxel of border so every neighbour lookup stays in the grid
+  Eigen::Vector3i dim = ((hi - lo) * info.scale).array().round().cast<int>() + 3;
+  long            stride_y = dim(2), stride_x = (long)dim(1) * dim(2);
+  std::vector<long> addr(points.size());
+  std::vector<uint8_t> occupied((size_t)dim(0) * stride_x, 0);
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    Eigen::Vector3f pt(points[i].x, points[i].y, points[i].z);
+    Eigen::Vector3i id = ((pt - lo) * info.scale).array().round().cast<int>() + 1;
+    addr[i]            = id(0) * stride_x + id(1) * stride_y + id(2);
+    occupied[addr[i]]  = 1;
+  }
+
+  std::vector<long> neighbours;
+  for (int dx = -1; dx <= 1; ++dx)
+    for (int dy = -1; dy <= 1; ++dy)
+      for (int dz = -1; dz <= 1; ++dz)
+        if (dx || dy || dz)
+          neighbours.push_back(dx * stride_x + dy * stride_y + dz);
+
+  std::vector<uint8_t> enclosed(points.size(), 0);
+#pragma omp parallel for schedule(static)
+  for (long i = 0; i < (long)points.size(); ++i)
+  {
+    bool all = true;
+    for (size_t n = 0; n < neighbours.size() && all; ++n)
+      all = occupied[addr[i] + neighbours[n]];
+    enclosed[i] = all;
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < points.size(); ++i)
+    if (!enclosed[i])
+      points[kept++] = points[i];
+  points.resize(kept);
+  info.cloud->width  = kept;
+  info.cloud->height = 1;
+
+  pcl2ros();
+  ROS_INFO("finish: number of points after optimization %d", info.cloud->width);
 }
 
 pcl::PointXYZ
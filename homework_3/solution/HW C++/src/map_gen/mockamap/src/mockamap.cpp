@@ -1,13 +1,14 @@
 #include "self_msgs_and_srvs/GlbObsRcv.h"
+#include "map_generator/tile_map_server.h"
 
 #include <ros/ros.h>
 #include <sensor_msgs/PointCloud2.h>
 
 #include <algorithm>
 #include <iostream>
+#include <memory>
 #include <vector>
 
-#include <pcl/kdtree/kdtree_flann.h>
 #include <pcl/point_cloud.h>
 #include <pcl_conversions/pcl_conversions.h>
 
@@ -16,55 +17,6 @@
 ros::Publisher           _pcl_pub;
 sensor_msgs::PointCloud2 _output;
 
-void
-optimizeMap(mocka::Maps::BasicInfo& in)
-{
-  std::vector<int>* temp = new std::vector<int>;
-
-  pcl::KdTreeFLANN<pcl::PointXYZ>     kdtree;
-  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-
-  cloud->width  = in.cloud->width;
-  cloud->height = in.cloud->height;
-  cloud->points.resize(cloud->width * cloud->height);
-
-  for (int i = 0; i < cloud->width; i++)
-  {
-    cloud->points[i].x = in.cloud->points[i].x;
-    cloud->points[i].y = in.cloud->points[i].y;
-    cloud->points[i].z = in.cloud->points[i].z;
-  }
-
-  kdtree.setInputCloud(cloud);
-  double radius = 1.75 / in.scale; // 1.75 is the rounded up value of sqrt(3)
-
-  for (int i = 0; i < cloud->width; i++)
-  {
-    std::vector<int>   pointIdxRadiusSearch;
-    std::vector<float> pointRadiusSquaredDistance;
-
-    if (kdtree.radiusSearch(cloud->points[i],
-                            radius,
-                            pointIdxRadiusSearch,
-                            pointRadiusSquaredDistance) >= 27)
-    {
-      temp->push_back(i);
-    }
-  }
-  for (int i = temp->size() - 1; i >= 0; i--)
-  {
-    in.cloud->points.erase(in.cloud->points.begin() +
-                           temp->at(i)); // erasing the enclosed points
-  }
-  in.cloud->width -= temp->size();
-
-  pcl::toROSMsg(*in.cloud, *in.output);
-  in.output->header.frame_id = "map";
-  ROS_INFO("finish: number of points after optimization %d", in.cloud->width);
-  delete temp;
-  return;
-}
-
 bool
 pubGlbObs(self_msgs_and_srvs::GlbObsRcv::Request&  req,
           self_msgs_and_srvs::GlbObsRcv::Response& res)
@@ -95,6 +47,7 @@ main(int argc, char** argv)
   double update_freq;
 
   int type;
+  bool tile_server;
 
   nh_private.param("seed", seed, 4546);
   nh_private.param("update_freq", update_freq, 1.0);
@@ -104,6 +57,7 @@ main(int argc, char** argv)
   nh_private.param("z_length", sizeZ, 10);
 
   nh_private.param("type", type, 1);
+  nh_private.param("tile_server/enable", tile_server, false);
 
   scale = 1 / scale;
   sizeX = sizeX * scale;
@@ -126,6 +80,12 @@ main(int argc, char** argv)
 
   ros::ServiceServer pub_glb_obs_service =
     nh_private.advertiseService("/pub_glb_obs", pubGlbObs);
+  std::unique_ptr<map_gen::TileMapServer> tile_map_server;
+  if (tile_server)
+  {
+    tile_map_server.reset(new map_gen::TileMapServer(nh_private));
+    tile_map_server->setMap(cloud);
+  }
   ros::spin();
 
   //! @note publish loop
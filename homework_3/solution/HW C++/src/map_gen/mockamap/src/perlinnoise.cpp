@@ -39,6 +39,8 @@ PerlinNoise::PerlinNoise()
         215, 61,  156, 180 };
   // Duplicate the permutation vector
   p.insert(p.end(), p.begin(), p.end());
+
+  initGradTable();
 }
 
 // Generate a new permutation vector based on the value of seed
@@ -57,6 +59,8 @@ PerlinNoise::PerlinNoise(unsigned int seed)
 
   // Duplicate the permutation vector
   p.insert(p.end(), p.begin(), p.end());
+
+  initGradTable();
 }
 
 double
@@ -101,6 +105,82 @@ PerlinNoise::noise(double x, double y, double z)
   return (res + 1.0) / 2.0;
 }
 
+void
+PerlinNoise::noiseColumn(double x, double y, const double* z, int n,
+                         double* out)
+{
+  int X = (int)floor(x) & 255;
+  int Y = (int)floor(y) & 255;
+  x -= floor(x);
+  y -= floor(y);
+  double u = fade(x);
+  double v = fade(y);
+
+  // the four lattice columns around (x, y): hash base and offset of the
+  // point
+  int    A          = p[X] + Y;
+  int    B          = p[X + 1] + Y;
+  int    column[4]  = { p[A], p[B], p[A + 1], p[B + 1] };
+  double dx[4]      = { x, x - 1, x, x - 1 };
+  double dy[4]      = { y, y, y - 1, y - 1 };
+
+  int k = 0;
+  while (k < n)
+  {
+    double zfloor = floor(z[k]);
+    int    Z      = (int)zfloor & 255;
+
+    // the gradients of the bottom and top corners of the cell, split into
+    // their x-y part and their z factor. Each corner value below is the sum
+    // grad() forms and the lerps run in noise()'s order, so the result is
+    // bit for bit the same as noise()
+    double xy0[4], z0[4], xy1[4], z1[4];
+    for (int c = 0; c < 4; ++c)
+    {
+      const double* g0 = gradTable[p[column[c] + Z] & 15];
+      const double* g1 = gradTable[p[column[c] + Z + 1] & 15];
+      xy0[c]           = g0[0] * dx[c] + g0[1] * dy[c];
+      z0[c]            = g0[2];
+      xy1[c]           = g1[0] * dx[c] + g1[1] * dy[c];
+      z1[c]            = g1[2];
+    }
+
+    int end = k + 1;
+    while (end < n && floor(z[end]) == zfloor)
+      ++end;
+    // a vectorization hint only, the loop is plain scalar code
+#pragma omp simd
+    for (int i = k; i < end; ++i)
+    {
+      double zf = z[i] - zfloor;
+      double w  = fade(zf);
+      double res =
+        lerp(w,
+             lerp(v, lerp(u, xy0[0] + z0[0] * zf, xy0[1] + z0[1] * zf),
+                  lerp(u, xy0[2] + z0[2] * zf, xy0[3] + z0[3] * zf)),
+             lerp(v,
+                  lerp(u, xy1[0] + z1[0] * (zf - 1),
+                       xy1[1] + z1[1] * (zf - 1)),
+                  lerp(u, xy1[2] + z1[2] * (zf - 1),
+                       xy1[3] + z1[3] * (zf - 1))));
+      out[i] = (res + 1.0) / 2.0;
+    }
+    k = end;
+  }
+}
+
+void
+PerlinNoise::initGradTable()
+{
+  // grad() is linear in (x, y, z)
+  for (int h = 0; h < 16; ++h)
+  {
+    gradTable[h][0] = grad(h, 1, 0, 0);
+    gradTable[h][1] = grad(h, 0, 1, 0);
+    gradTable[h][2] = grad(h, 0, 0, 1);
+  }
+}
+
 double
 PerlinNoise::fade(double t)
 {
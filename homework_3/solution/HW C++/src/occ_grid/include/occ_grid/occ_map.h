@@ -22,11 +22,17 @@ OF SUCH DAMAGE.
 #define _OCC_MAP_H
 
 #include "raycast.h"
+#include "occ_storage.h"
+#include "self_msgs_and_srvs/GetMapTiles.h"
+#include "self_msgs_and_srvs/MapTileArray.h"
 
 #include <pcl/point_types.h>
 #include <pcl_conversions/pcl_conversions.h>
+#include <nav_msgs/Odometry.h>
 #include <Eigen/Eigen>
 #include <ros/ros.h>
+#include <mutex>
+#include <unordered_map>
 
 using std::cout;
 using std::endl;
@@ -48,12 +54,16 @@ namespace env
     double getResolution() { return resolution_; }
     Eigen::Vector3d getOrigin() { return origin_; }
     Eigen::Vector3d getMapSize() { return map_size_; };
+    size_t getMemoryUsage() const;
     bool isStateValid(const Eigen::Vector3d &pos) const
     {
       Eigen::Vector3i idx = posToIndex(pos);
       if (!isInMap(idx))
         return false;
-      return (occupancy_buffer_[idxToAddress(idx)] == false);
+      // a global map has no ring offset, the index addresses the buffer directly
+      if (!local_sensing_)
+        return (occupancy_buffer_.test(idx(0), idx(1), idx(2), idxToAddress(idx)) == false);
+      return (isBlockOccupied(0, idx(0), idx(1), idx(2)) == false);
     };
     bool isSegmentValid(const Eigen::Vector3d &p0, const Eigen::Vector3d &p1, double max_dist = DBL_MAX) const
     {
@@ -63,33 +73,47 @@ namespace env
       {
         return false;
       }
-      RayCaster raycaster;
-      bool need_ray = raycaster.setInput(p0 / resolution_, p1 / resolution_); //(ray start, ray end)
-      if (!need_ray)
-        return true;
-      Eigen::Vector3d half = Eigen::Vector3d(0.5, 0.5, 0.5);
-      Eigen::Vector3d ray_pt;
-      if (!raycaster.step(ray_pt)) // skip the ray start point
-        return true;
-      while (raycaster.step(ray_pt))
-      {
-        Eigen::Vector3d tmp = (ray_pt + half) * resolution_;
-        if (!this->isStateValid(tmp))
-        {
-          return false;
-        }
-      }
-      return true;
+      if (pyramid_levels_ > 0 || dist * resolution_inv_ >= IntRayCaster::MAX_VOXELS)
+        return isSegmentValidHierarchical(p0, p1);
+      if (!isInMap(posToIndex(p0)) || !isInMap(posToIndex(p1)))
+        return false;
+      IntRayCaster raycaster;
+      raycaster.setInput((p0 - origin_) * resolution_inv_, (p1 - origin_) * resolution_inv_, address_strides_);
+      return isRayFree(raycaster);
     }
+    // check the segments from a shared start p0 to each of p1s, e.g. all neighbour edges of a tree node
+    void areSegmentsValid(const Eigen::Vector3d &p0, const std::vector<Eigen::Vector3d> &p1s, std::vector<bool> &valid,
+                          double max_dist = DBL_MAX) const;
+
+    // occupy the voxels of a whole known map at once, what /global_cloud does when it arrives
+    void setGlobalMap(const pcl::PointCloud<pcl::PointXYZ> &global_cloud);
+
+    // fuse one scan of world-frame points sensed from sensor_pos, local sensing mode only
+    void updateLocalMap(const Eigen::Vector3d &sensor_pos, const std::vector<Eigen::Vector3d> &points);
+
+    // log of voxels that turned occupied, for planners that keep state across map updates. Gives the
+    // centres of the voxels occupied after stamp, false if the log cannot tell (map reset, window moved)
+    size_t getOccupancyStamp() const { return occ_stamp_; }
+    bool getOccupiedSince(size_t stamp, std::vector<Eigen::Vector3d> &voxels) const;
+
+    // held by the ROS callbacks that change the map (map tiles, local scans). A planner on another
+    // spinner thread holds it for a whole query, so the map does not change under the search
+    std::mutex &getUpdateMutex() { return update_mutex_; }
 
     typedef shared_ptr<OccMap> Ptr;
 
   private:
-    std::vector<bool> occupancy_buffer_;
+    OccupancyStorage occupancy_buffer_;
+
+    // occupancy pyramid, occ_pyramid_[l - 1] max-pools blocks of 2^l voxels per axis
+    int pyramid_levels_;
+    std::vector<DenseBitset> occ_pyramid_;
+    std::vector<Eigen::Vector3i> pyramid_grid_size_;
 
     // map property
     Eigen::Vector3i grid_size_; // map size in index
     int grid_size_y_multiply_z_;
+    Eigen::Vector3i address_strides_;
 
     int idxToAddress(const int &x_id, const int &y_id, const int &z_id) const;
     int idxToAddress(const Eigen::Vector3i &id) const;
@@ -100,18 +124,73 @@ namespace env
     bool isInMap(const Eigen::Vector3d &pos) const;
     bool isInMap(const Eigen::Vector3i &id) const;
 
+    void clampPyramidLevels();
+    void initPyramid();
+    Eigen::Vector3i toBufferIndex(const Eigen::Vector3i &id, int level) const;
+    Eigen::Vector3i fromBufferIndex(const Eigen::Vector3i &buffer_id, int level) const;
+    bool isBlockOccupied(int level, int x_id, int y_id, int z_id) const;
+    // clip a segment in voxel units to the grid box, false if it misses the grid
+    bool clipToGrid(Eigen::Vector3d &start, Eigen::Vector3d &end) const;
+    bool isSegmentValidHierarchical(const Eigen::Vector3d &p0, const Eigen::Vector3d &p1) const;
+    bool isRayFree(IntRayCaster &raycaster) const;
+    bool isRayFree(int level, const Eigen::Vector3i &parent, const Eigen::Vector3d &start,
+                   const Eigen::Vector3d &dir, double t_start, double t_end) const;
+
     Eigen::Vector3d origin_, map_size_, min_range_, max_range_;
     double resolution_, resolution_inv_;
 
+    // local sensing, log-odds occupancy in a window that recenters on the sensor. The window is a
+    // ring buffer, index id of the window lives at (id + ring_offset_) mod grid_size_ in the buffers
+    bool local_sensing_;
+    double max_ray_length_, recenter_margin_;
+    float l_hit_, l_miss_, l_min_, l_max_, l_occ_;
+    Eigen::Vector3i ring_offset_;
+    std::vector<float> log_odds_;
+    std::vector<uint8_t> scan_flag_; // per scan: 0 untouched, 1 passed through, 2 hit
+    std::vector<int> scan_touched_;
+    Eigen::Vector3d sensor_pos_;
+    bool has_odom_;
+
+    // occ_log_ holds the voxels occupied at stamps [occ_log_begin_, occ_stamp_)
+    size_t occ_stamp_, occ_log_begin_;
+    std::vector<Eigen::Vector3d> occ_log_;
+    void resetOccupancyLog();
+
+    // tiled global map, pulled from /get_map_tiles for the map box and kept up to date by the tile deltas.
+    // Tiles need not align with voxels, so each tile keeps the voxels it occupies and tile_refs_ counts the
+    // tiles (and the map boundary) holding a voxel, it turns free once none does. Tiles are expected to be
+    // larger than a voxel, then at most 8 of them share one. A server going back in version restarted, then
+    // all tiles are dropped and fetched again
+    bool use_map_tiles_;
+    uint32_t map_version_;
+    std::unordered_map<int64_t, std::vector<int>> tile_voxels_;
+    std::vector<uint8_t> tile_refs_;
+    void applyMapTiles(const self_msgs_and_srvs::MapTileArray &tiles);
+    void resetMapTiles();
+
+    std::mutex update_mutex_;
+
     // ros
     ros::NodeHandle node_;
-    ros::Subscriber global_cloud_sub_;
-    ros::Timer global_occ_vis_timer_;
+    ros::Subscriber global_cloud_sub_, local_cloud_sub_, odom_sub_;
+    ros::Timer global_occ_vis_timer_, tile_fetch_timer_;
     ros::Publisher glb_occ_pub_;
+    ros::Subscriber tile_update_sub_;
+    ros::ServiceClient tile_client_;
 
     void setOccupancy(const Eigen::Vector3d &pos);
+    void setOccupancy(const Eigen::Vector3i &id);
+    void clearOccupancy(const Eigen::Vector3i &id);
+    void addressToIdx(int addr, Eigen::Vector3i &id) const;
+    void recenter(const Eigen::Vector3d &center);
+    void clearBox(const Eigen::Vector3i &lo, const Eigen::Vector3i &hi);
+    void occupancyToCloud();
     void globalOccVisCallback(const ros::TimerEvent &e);
     void globalCloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg);
+    void localCloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg);
+    void tileFetchCallback(const ros::TimerEvent &e);
+    void tileUpdateCallback(const self_msgs_and_srvs::MapTileArrayConstPtr &msg);
+    void odomCallback(const nav_msgs::OdometryConstPtr &msg);
 
     pcl::PointCloud<pcl::PointXYZ>::Ptr glb_cloud_ptr_;
     bool is_global_map_valid_;
@@ -127,6 +206,49 @@ namespace env
     return id(0) * grid_size_y_multiply_z_ + id(1) * grid_size_(2) + id(2);
   }
 
+  inline Eigen::Vector3i OccMap::toBufferIndex(const Eigen::Vector3i &id, int level) const
+  {
+    const Eigen::Vector3i &size = level == 0 ? grid_size_ : pyramid_grid_size_[level - 1];
+    Eigen::Vector3i buffer_id;
+    for (int i = 0; i < 3; ++i)
+    {
+      buffer_id(i) = id(i) + (ring_offset_(i) >> level);
+      if (buffer_id(i) >= size(i))
+        buffer_id(i) -= size(i);
+    }
+    return buffer_id;
+  }
+
+  inline Eigen::Vector3i OccMap::fromBufferIndex(const Eigen::Vector3i &buffer_id, int level) const
+  {
+    const Eigen::Vector3i &size = level == 0 ? grid_size_ : pyramid_grid_size_[level - 1];
+    Eigen::Vector3i id;
+    for (int i = 0; i < 3; ++i)
+    {
+      id(i) = buffer_id(i) - (ring_offset_(i) >> level);
+      if (id(i) < 0)
+        id(i) += size(i);
+    }
+    return id;
+  }
+
+  inline bool OccMap::isBlockOccupied(int level, int x_id, int y_id, int z_id) const
+  {
+    Eigen::Vector3i buffer_id = toBufferIndex(Eigen::Vector3i(x_id, y_id, z_id), level);
+    if (level == 0)
+      return occupancy_buffer_.test(buffer_id(0), buffer_id(1), buffer_id(2));
+    const Eigen::Vector3i &size = pyramid_grid_size_[level - 1];
+    return occ_pyramid_[level - 1].test((buffer_id(0) * size(1) + buffer_id(1)) * size(2) + buffer_id(2));
+  }
+
+  inline void OccMap::addressToIdx(int addr, Eigen::Vector3i &id) const
+  {
+    id(0) = addr / grid_size_y_multiply_z_;
+    addr -= id(0) * grid_size_y_multiply_z_;
+    id(1) = addr / grid_size_(2);
+    id(2) = addr - id(1) * grid_size_(2);
+  }
+
   inline bool OccMap::isInMap(const Eigen::Vector3d &pos) const
   {
     Eigen::Vector3i idx;
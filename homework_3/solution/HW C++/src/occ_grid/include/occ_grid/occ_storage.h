@@ -0,0 +1,165 @@
+#ifndef _OCC_STORAGE_H
+#define _OCC_STORAGE_H
+
+#include <Eigen/Eigen>
+#include <cstdint>
+#include <vector>
+
+namespace env
+{
+  // Flat bitset over linear addresses, 64 voxels per word.
+  class DenseBitset
+  {
+  public:
+    void assign(size_t bit_num, bool value)
+    {
+      bit_num_ = bit_num;
+      words_.assign((bit_num + 63) >> 6, value ? ~uint64_t(0) : uint64_t(0));
+    }
+    bool test(size_t addr) const { return (words_[addr >> 6] >> (addr & 63)) & 1; }
+    void set(size_t addr) { words_[addr >> 6] |= uint64_t(1) << (addr & 63); }
+    void reset(size_t addr) { words_[addr >> 6] &= ~(uint64_t(1) << (addr & 63)); }
+    const uint64_t &word(size_t i) const { return words_[i]; }
+    size_t wordNum() const { return words_.size(); }
+    size_t size() const { return bit_num_; }
+    size_t memoryUsage() const { return words_.capacity() * sizeof(uint64_t); }
+
+  private:
+    size_t bit_num_ = 0;
+    std::vector<uint64_t, Eigen::aligned_allocator<uint64_t>> words_;
+  };
+
+  // VDB-like two level layout: a dense table of leaf indices over 8x8x8 blocks, leaves are
+  // allocated on first occupied voxel, so empty space costs one int per 512 voxels.
+  class BlockSparseBitset
+  {
+  public:
+    static const int LEAF_BITS = 3;
+    static const int LEAF_DIM = 1 << LEAF_BITS;
+
+    void init(const Eigen::Vector3i &grid_size)
+    {
+      for (int i = 0; i < 3; ++i)
+        block_num_(i) = (grid_size(i) + LEAF_DIM - 1) >> LEAF_BITS;
+      leaf_index_.assign(block_num_(0) * block_num_(1) * block_num_(2), -1);
+      leaves_.clear();
+    }
+    bool test(int x, int y, int z) const
+    {
+      int leaf = leaf_index_[blockAddress(x, y, z)];
+      if (leaf < 0)
+        return false;
+      return (leaves_[leaf].words[x & (LEAF_DIM - 1)] >> inLeafBit(y, z)) & 1;
+    }
+    void set(int x, int y, int z)
+    {
+      int &leaf = leaf_index_[blockAddress(x, y, z)];
+      if (leaf < 0)
+      {
+        leaf = leaves_.size();
+        leaves_.emplace_back();
+      }
+      leaves_[leaf].words[x & (LEAF_DIM - 1)] |= uint64_t(1) << inLeafBit(y, z);
+    }
+    void reset(int x, int y, int z)
+    {
+      int leaf = leaf_index_[blockAddress(x, y, z)];
+      if (leaf >= 0)
+        leaves_[leaf].words[x & (LEAF_DIM - 1)] &= ~(uint64_t(1) << inLeafBit(y, z));
+    }
+    void clear()
+    {
+      std::fill(leaf_index_.begin(), leaf_index_.end(), -1);
+      leaves_.clear();
+    }
+    size_t leafNum() const { return leaves_.size(); }
+    size_t memoryUsage() const { return leaf_index_.capacity() * sizeof(int) + leaves_.capacity() * sizeof(Leaf); }
+
+  private:
+    // one word per x slice of the leaf, 8x8 (y, z) bits per word
+    struct Leaf
+    {
+      uint64_t words[LEAF_DIM] = {0};
+    };
+    Eigen::Vector3i block_num_;
+    std::vector<int> leaf_index_;
+    std::vector<Leaf> leaves_;
+
+    int blockAddress(int x, int y, int z) const
+    {
+      return ((x >> LEAF_BITS) * block_num_(1) + (y >> LEAF_BITS)) * block_num_(2) + (z >> LEAF_BITS);
+    }
+    static int inLeafBit(int y, int z) { return ((y & (LEAF_DIM - 1)) << LEAF_BITS) | (z & (LEAF_DIM - 1)); }
+  };
+
+  // Binary occupancy of the voxel grid, backed by either layout. path_finder's occ_map_benchmark
+  // compares their memory and query rates with the former std::vector<bool>.
+  class OccupancyStorage
+  {
+  public:
+    enum Type
+    {
+      DENSE,
+      BLOCK_SPARSE
+    };
+
+    void init(const Eigen::Vector3i &grid_size, Type type)
+    {
+      type_ = type;
+      grid_size_ = grid_size;
+      grid_size_y_multiply_z_ = grid_size(1) * grid_size(2);
+      if (type_ == DENSE)
+        dense_.assign(size_t(grid_size(0)) * grid_size_y_multiply_z_, false);
+      else
+        sparse_.init(grid_size);
+    }
+    bool test(int x, int y, int z) const
+    {
+      if (type_ == DENSE)
+        return dense_.test(address(x, y, z));
+      return sparse_.test(x, y, z);
+    }
+    // the linear address spares the dense layout its address computation
+    bool test(int x, int y, int z, size_t addr) const
+    {
+      if (type_ == DENSE)
+        return dense_.test(addr);
+      return sparse_.test(x, y, z);
+    }
+    void set(int x, int y, int z)
+    {
+      if (type_ == DENSE)
+        dense_.set(address(x, y, z));
+      else
+        sparse_.set(x, y, z);
+    }
+    void reset(int x, int y, int z)
+    {
+      if (type_ == DENSE)
+        dense_.reset(address(x, y, z));
+      else
+        sparse_.reset(x, y, z);
+    }
+    void clear()
+    {
+      if (type_ == DENSE)
+        dense_.assign(dense_.size(), false);
+      else
+        sparse_.clear();
+    }
+    Type getType() const { return type_; }
+    size_t memoryUsage() const { return type_ == DENSE ? dense_.memoryUsage() : sparse_.memoryUsage(); }
+
+  private:
+    Type type_ = DENSE;
+    Eigen::Vector3i grid_size_;
+    size_t grid_size_y_multiply_z_;
+    DenseBitset dense_;
+    BlockSparseBitset sparse_;
+
+    size_t address(int x, int y, int z) const { return x * grid_size_y_multiply_z_ + y * grid_size_(2) + z; }
+  };
+
+} // namespace env
+
+#endif
@@ -2,6 +2,7 @@
 #define RAYCAST_H_
 
 #include <Eigen/Eigen>
+#include <cstdint>
 #include <vector>
 
 double signum(double x);
@@ -62,4 +63,48 @@ public:
   bool step(Eigen::Vector3d& ray_pt);
 };
 
+// Integer Amanatides-Woo traversal. The endpoints are snapped to a fixed-point grid of
+// 2^FRAC_BITS steps per voxel and the boundary crossings are compared by cross-multiplication,
+// so the voxels visited are exactly the ones the segment passes, from the start voxel to the end
+// voxel included, and the linear address is carried along with the index.
+// Segments must stay below MAX_VOXELS per axis to keep the products in 64 bits.
+class IntRayCaster
+{
+private:
+  Eigen::Vector3i id_;
+  Eigen::Matrix<int64_t, 3, 1> start_fixed_;
+  int step_[3];
+  int64_t addr_;
+  int64_t addr_step_[3];
+  int64_t t_max_[3];
+  int64_t t_delta_[3];
+  int steps_left_;
+
+public:
+  static const int FRAC_BITS = 10;
+  static const int MAX_VOXELS = 1 << 10;
+
+  // start, end in voxel units, strides are the address increments of one voxel along x, y, z
+  void setInput(const Eigen::Vector3d& start, const Eigen::Vector3d& end, const Eigen::Vector3i& strides);
+
+  // set the start once for many segments sharing it, then each end
+  void setStart(const Eigen::Vector3d& start);
+  void setEnd(const Eigen::Vector3d& end, const Eigen::Vector3i& strides);
+
+  // outputs the current voxel, returns false if it is the end voxel
+  bool step(Eigen::Vector3i& id, int64_t& addr)
+  {
+    id = id_;
+    addr = addr_;
+    if (steps_left_ == 0)
+      return false;
+    --steps_left_;
+    int axis = (t_max_[0] < t_max_[1]) ? (t_max_[0] < t_max_[2] ? 0 : 2) : (t_max_[1] < t_max_[2] ? 1 : 2);
+    id_(axis) += step_[axis];
+    addr_ += addr_step_[axis];
+    t_max_[axis] += t_delta_[axis];
+    return true;
+  }
+};
+
 #endif  // RAYCAST_H_
\ No newline at end of file
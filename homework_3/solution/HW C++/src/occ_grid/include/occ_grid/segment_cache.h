@@ -0,0 +1,102 @@
+#ifndef _SEGMENT_CACHE_H
+#define _SEGMENT_CACHE_H
+
+#include <Eigen/Eigen>
+#include <functional>
+#include <vector>
+
+namespace env
+{
+  // Direct-mapped cache of recent segment collision checks. Segments are keyed by their exact
+  // endpoints regardless of direction, so the same edge checked in choose-parent and in rewire
+  // only hits the map once. Must be cleared whenever the map changes. The table is only allocated
+  // on the first insert, an unused cache costs nothing.
+  class SegmentCache
+  {
+  public:
+    SegmentCache(int capacity_bits = 14) : capacity_bits_(capacity_bits), mask_(0), hits_(0), misses_(0) {}
+
+    bool query(const Eigen::Vector3d &p0, const Eigen::Vector3d &p1, bool &valid)
+    {
+      if (table_.empty())
+      {
+        ++misses_;
+        return false;
+      }
+      const Eigen::Vector3d &a = lessThan(p0, p1) ? p0 : p1;
+      const Eigen::Vector3d &b = lessThan(p0, p1) ? p1 : p0;
+      const Entry &e = table_[hash(a, b) & mask_];
+      if (e.used && e.a == a && e.b == b)
+      {
+        valid = e.valid;
+        ++hits_;
+        return true;
+      }
+      ++misses_;
+      return false;
+    }
+
+    void insert(const Eigen::Vector3d &p0, const Eigen::Vector3d &p1, bool valid)
+    {
+      if (table_.empty())
+      {
+        table_.resize(size_t(1) << capacity_bits_);
+        mask_ = table_.size() - 1;
+      }
+      const Eigen::Vector3d &a = lessThan(p0, p1) ? p0 : p1;
+      const Eigen::Vector3d &b = lessThan(p0, p1) ? p1 : p0;
+      Entry &e = table_[hash(a, b) & mask_];
+      e.a = a;
+      e.b = b;
+      e.valid = valid;
+      e.used = true;
+    }
+
+    void clear()
+    {
+      for (auto &e : table_)
+        e.used = false;
+      hits_ = 0;
+      misses_ = 0;
+    }
+
+    size_t getHits() const { return hits_; }
+    size_t getMisses() const { return misses_; }
+
+  private:
+    struct Entry
+    {
+      Eigen::Vector3d a, b;
+      bool valid;
+      bool used;
+    };
+    int capacity_bits_;
+    std::vector<Entry> table_;
+    size_t mask_;
+    size_t hits_, misses_;
+
+    static bool lessThan(const Eigen::Vector3d &p0, const Eigen::Vector3d &p1)
+    {
+      if (p0(0) != p1(0))
+        return p0(0) < p1(0);
+      if (p0(1) != p1(1))
+        return p0(1) < p1(1);
+      return p0(2) < p1(2);
+    }
+
+    static size_t hash(const Eigen::Vector3d &a, const Eigen::Vector3d &b)
+    {
+      std::hash<double> h;
+      size_t seed = 0;
+      for (int i = 0; i < 3; ++i)
+      {
+        seed ^= h(a(i)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        seed ^= h(b(i)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      }
+      return seed;
+    }
+  };
+
+} // namespace env
+
+#endif
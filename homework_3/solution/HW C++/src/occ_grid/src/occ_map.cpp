@@ -25,8 +25,12 @@ OF SUCH DAMAGE.
 #include <tf2_ros/static_transform_broadcaster.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <tf2/LinearMath/Quaternion.h>
+#include <algorithm>
 #include <chrono>
 #include <random>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace env
 {
@@ -38,11 +42,428 @@ namespace env
     if (!isInMap(id))
       return;
 
-    occupancy_buffer_[idxToAddress(id)] = true;
+    setOccupancy(id);
+  }
+
+  inline void OccMap::setOccupancy(const Eigen::Vector3i &id)
+  {
+    Eigen::Vector3i buffer_id = toBufferIndex(id, 0);
+    occupancy_buffer_.set(buffer_id(0), buffer_id(1), buffer_id(2));
+
+    // max-pool upwards, a block is occupied as soon as one voxel inside is
+    for (int l = 1; l <= pyramid_levels_; ++l)
+    {
+      const Eigen::Vector3i &size = pyramid_grid_size_[l - 1];
+      buffer_id = toBufferIndex(Eigen::Vector3i(id(0) >> l, id(1) >> l, id(2) >> l), l);
+      occ_pyramid_[l - 1].set((buffer_id(0) * size(1) + buffer_id(1)) * size(2) + buffer_id(2));
+    }
+  }
+
+  void OccMap::clearOccupancy(const Eigen::Vector3i &id)
+  {
+    Eigen::Vector3i buffer_id = toBufferIndex(id, 0);
+    occupancy_buffer_.reset(buffer_id(0), buffer_id(1), buffer_id(2));
+
+    // a block turns free only once all its 8 children are free
+    for (int l = 1; l <= pyramid_levels_; ++l)
+    {
+      const Eigen::Vector3i &child_size = l == 1 ? grid_size_ : pyramid_grid_size_[l - 2];
+      Eigen::Vector3i block(id(0) >> l, id(1) >> l, id(2) >> l);
+      for (int x = block(0) * 2; x <= min(block(0) * 2 + 1, child_size(0) - 1); ++x)
+        for (int y = block(1) * 2; y <= min(block(1) * 2 + 1, child_size(1) - 1); ++y)
+          for (int z = block(2) * 2; z <= min(block(2) * 2 + 1, child_size(2) - 1); ++z)
+            if (isBlockOccupied(l - 1, x, y, z))
+              return;
+      const Eigen::Vector3i &size = pyramid_grid_size_[l - 1];
+      buffer_id = toBufferIndex(block, l);
+      occ_pyramid_[l - 1].reset((buffer_id(0) * size(1) + buffer_id(1)) * size(2) + buffer_id(2));
+    }
+  }
+
+  void OccMap::updateLocalMap(const Eigen::Vector3d &sensor_pos, const std::vector<Eigen::Vector3d> &points)
+  {
+    if (!local_sensing_)
+      return;
+    recenter(sensor_pos);
+
+    // raycast every point in parallel, each thread collects the voxels its rays pass and hit
+    int thread_num = 1;
+#ifdef _OPENMP
+    thread_num = omp_get_max_threads();
+#endif
+    std::vector<std::vector<int>> pass_addrs(thread_num), hit_addrs(thread_num);
+    Eigen::Vector3d ray_start = (sensor_pos - origin_) * resolution_inv_;
+    // the fixed-point caster takes rays shorter than MAX_VOXELS
+    const double max_ray_voxels = IntRayCaster::MAX_VOXELS - 1;
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < (int)points.size(); ++i)
+    {
+      int tid = 0;
+#ifdef _OPENMP
+      tid = omp_get_thread_num();
+#endif
+      Eigen::Vector3d dir = points[i] - sensor_pos;
+      double len = dir.norm();
+      bool is_hit = len <= max_ray_length_;
+      Eigen::Vector3d ray_end = is_hit ? points[i] : Eigen::Vector3d(sensor_pos + dir * (max_ray_length_ / len));
+      ray_end = (ray_end - origin_) * resolution_inv_;
+
+      Eigen::Vector3d start = ray_start, end = ray_end;
+      double voxel_len = (end - start).norm();
+      if (voxel_len > max_ray_voxels)
+        end = start + (end - start) * (max_ray_voxels / voxel_len);
+      if (clipToGrid(start, end))
+      {
+        IntRayCaster raycaster;
+        raycaster.setInput(start, end, address_strides_);
+        Eigen::Vector3i id;
+        int64_t addr;
+        bool not_end = true;
+        while (not_end)
+        {
+          not_end = raycaster.step(id, addr);
+          pass_addrs[tid].push_back(idxToAddress(toBufferIndex(id, 0)));
+        }
+      }
+      Eigen::Vector3i end_id = ray_end.array().floor().cast<int>();
+      if (is_hit && isInMap(end_id))
+        hit_addrs[tid].push_back(idxToAddress(toBufferIndex(end_id, 0)));
+    }
+
+    // deduplicate so each voxel is updated once per scan, a hit wins over a pass. The addresses
+    // here and in log_odds_ are ring buffer addresses
+    for (int t = 0; t < thread_num; ++t)
+    {
+      for (int addr : pass_addrs[t])
+        if (scan_flag_[addr] == 0)
+        {
+          scan_flag_[addr] = 1;
+          scan_touched_.push_back(addr);
+        }
+      for (int addr : hit_addrs[t])
+      {
+        if (scan_flag_[addr] == 0)
+          scan_touched_.push_back(addr);
+        scan_flag_[addr] = 2;
+      }
+    }
+
+    Eigen::Vector3i id;
+    for (int addr : scan_touched_)
+    {
+      bool was_occ = log_odds_[addr] > l_occ_;
+      log_odds_[addr] = std::max(l_min_, std::min(l_max_, log_odds_[addr] + (scan_flag_[addr] == 2 ? l_hit_ : l_miss_)));
+      scan_flag_[addr] = 0;
+      bool is_occ = log_odds_[addr] > l_occ_;
+      if (was_occ == is_occ)
+        continue;
+      addressToIdx(addr, id);
+      id = fromBufferIndex(id, 0);
+      if (is_occ)
+      {
+        setOccupancy(id);
+        Eigen::Vector3d pos;
+        indexToPos(id, pos);
+        occ_log_.push_back(pos);
+        ++occ_stamp_;
+      }
+      else
+        clearOccupancy(id);
+    }
+    // the log is only meant to span a few scans between two plans
+    if (occ_log_.size() > 65536)
+      resetOccupancyLog();
+    scan_touched_.clear();
+    is_global_map_valid_ = true;
+  }
+
+  void OccMap::recenter(const Eigen::Vector3d &center)
+  {
+    Eigen::Vector3d offset = center - (origin_ + map_size_ / 2);
+    if (offset.cwiseAbs().maxCoeff() <= recenter_margin_)
+      return;
+
+    // scroll by whole top level blocks so the pyramid blocks stay aligned with the ring buffer,
+    // then only the slabs scrolled in are cleared, as unknown
+    int block = 1 << pyramid_levels_;
+    Eigen::Vector3i shift;
+    for (int i = 0; i < 3; ++i)
+      shift(i) = fabs(offset(i)) > recenter_margin_ ? int(round(offset(i) * resolution_inv_ / block)) * block : 0;
+    origin_ += shift.cast<double>() * resolution_;
+    min_range_ = origin_;
+    max_range_ = origin_ + map_size_;
+    for (int i = 0; i < 3; ++i)
+      ring_offset_(i) = ((ring_offset_(i) + shift(i)) % grid_size_(i) + grid_size_(i)) % grid_size_(i);
+    resetOccupancyLog();
+
+    if ((shift.cwiseAbs() - grid_size_).maxCoeff() >= 0)
+    {
+      std::fill(log_odds_.begin(), log_odds_.end(), 0.0f);
+      occupancy_buffer_.clear();
+      for (auto &level : occ_pyramid_)
+        level.assign(level.size(), false);
+      return;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      if (shift(i) == 0)
+        continue;
+      Eigen::Vector3i lo = Eigen::Vector3i::Zero(), hi = grid_size_;
+      if (shift(i) > 0)
+        lo(i) = grid_size_(i) - shift(i);
+      else
+        hi(i) = -shift(i);
+      clearBox(lo, hi);
+    }
+  }
+
+  void OccMap::clearBox(const Eigen::Vector3i &lo, const Eigen::Vector3i &hi)
+  {
+    Eigen::Vector3i id;
+    for (id(0) = lo(0); id(0) < hi(0); ++id(0))
+      for (id(1) = lo(1); id(1) < hi(1); ++id(1))
+        for (id(2) = lo(2); id(2) < hi(2); ++id(2))
+        {
+          float &log_odds = log_odds_[idxToAddress(toBufferIndex(id, 0))];
+          if (log_odds > l_occ_)
+            clearOccupancy(id);
+          log_odds = 0.0f;
+        }
+  }
+
+  void OccMap::resetOccupancyLog()
+  {
+    occ_log_.clear();
+    ++occ_stamp_;
+    occ_log_begin_ = occ_stamp_;
+  }
+
+  bool OccMap::getOccupiedSince(size_t stamp, std::vector<Eigen::Vector3d> &voxels) const
+  {
+    if (stamp < occ_log_begin_)
+      return false;
+    voxels.assign(occ_log_.begin() + (stamp - occ_log_begin_), occ_log_.end());
+    return true;
+  }
+
+  void OccMap::clampPyramidLevels()
+  {
+    // no use to pool beyond the level where the whole map fits in 2 blocks per axis
+    int max_levels = 0;
+    while ((grid_size_.maxCoeff() >> (max_levels + 1)) > 1)
+      ++max_levels;
+    pyramid_levels_ = max(0, min(pyramid_levels_, max_levels));
+  }
+
+  void OccMap::initPyramid()
+  {
+    clampPyramidLevels();
+    occ_pyramid_.resize(pyramid_levels_);
+    pyramid_grid_size_.resize(pyramid_levels_);
+    for (int l = 1; l <= pyramid_levels_; ++l)
+    {
+      Eigen::Vector3i &size = pyramid_grid_size_[l - 1];
+      for (int i = 0; i < 3; ++i)
+        size(i) = ((grid_size_(i) - 1) >> l) + 1;
+      occ_pyramid_[l - 1].assign(size(0) * size(1) * size(2), false);
+    }
+  }
+
+  size_t OccMap::getMemoryUsage() const
+  {
+    size_t bytes = occupancy_buffer_.memoryUsage();
+    for (const auto &level : occ_pyramid_)
+      bytes += level.memoryUsage();
+    return bytes;
+  }
+
+  void OccMap::areSegmentsValid(const Eigen::Vector3d &p0, const std::vector<Eigen::Vector3d> &p1s, std::vector<bool> &valid,
+                                double max_dist) const
+  {
+    valid.assign(p1s.size(), false);
+    if (!isStateValid(p0))
+      return;
+    IntRayCaster raycaster;
+    raycaster.setStart((p0 - origin_) * resolution_inv_);
+    for (size_t i = 0; i < p1s.size(); ++i)
+    {
+      double dist = (p1s[i] - p0).norm();
+      if (dist > max_dist || !isInMap(posToIndex(p1s[i])))
+        continue;
+      if (pyramid_levels_ > 0 || dist * resolution_inv_ >= IntRayCaster::MAX_VOXELS)
+      {
+        valid[i] = isSegmentValidHierarchical(p0, p1s[i]);
+        continue;
+      }
+      raycaster.setEnd((p1s[i] - origin_) * resolution_inv_, address_strides_);
+      Eigen::Vector3i id;
+      int64_t addr;
+      raycaster.step(id, addr); // the shared start voxel is checked once above
+      valid[i] = isRayFree(raycaster);
+    }
+  }
+
+  bool OccMap::isRayFree(IntRayCaster &raycaster) const
+  {
+    Eigen::Vector3i id;
+    int64_t addr;
+    bool not_end = true;
+    if (local_sensing_)
+    {
+      // the window addresses of the raycaster do not match the ring buffer
+      while (not_end)
+      {
+        not_end = raycaster.step(id, addr);
+        if (isBlockOccupied(0, id(0), id(1), id(2)))
+          return false;
+      }
+      return true;
+    }
+    while (not_end)
+    {
+      not_end = raycaster.step(id, addr);
+      if (occupancy_buffer_.test(id(0), id(1), id(2), addr))
+        return false;
+    }
+    return true;
+  }
+
+  bool OccMap::clipToGrid(Eigen::Vector3d &start, Eigen::Vector3d &end) const
+  {
+    // the far faces are pulled in by one fixed-point unit, so the caster floors onto the last voxel
+    const Eigen::Vector3d hi = grid_size_.cast<double>() - Eigen::Vector3d::Constant(1.0 / (1 << IntRayCaster::FRAC_BITS));
+    Eigen::Vector3d dir = end - start;
+    double t_in = 0.0, t_out = 1.0;
+    for (int i = 0; i < 3; ++i)
+    {
+      if (dir(i) == 0.0)
+      {
+        if (start(i) < 0.0 || start(i) > hi(i))
+          return false;
+        continue;
+      }
+      double t_lo = -start(i) / dir(i), t_hi = (hi(i) - start(i)) / dir(i);
+      if (t_lo > t_hi)
+        std::swap(t_lo, t_hi);
+      t_in = max(t_in, t_lo);
+      t_out = min(t_out, t_hi);
+    }
+    if (t_in > t_out)
+      return false;
+    Eigen::Vector3d clipped_start = start + t_in * dir;
+    end = (start + t_out * dir).cwiseMax(0.0).cwiseMin(hi);
+    start = clipped_start.cwiseMax(0.0).cwiseMin(hi);
+    return true;
+  }
+
+  bool OccMap::isSegmentValidHierarchical(const Eigen::Vector3d &p0, const Eigen::Vector3d &p1) const
+  {
+    if (!isInMap(posToIndex(p0)) || !isInMap(posToIndex(p1)))
+      return false;
+
+    // work in continuous voxel coordinates, the segment is p0 + t * dir with t in [0, 1]
+    Eigen::Vector3d start = (p0 - origin_) * resolution_inv_;
+    Eigen::Vector3d dir = (p1 - origin_) * resolution_inv_ - start;
+    Eigen::Vector3i root = Eigen::Vector3i::Zero();
+    return isRayFree(pyramid_levels_, root, start, dir, 0.0, 1.0);
+  }
+
+  bool OccMap::isRayFree(int level, const Eigen::Vector3i &parent, const Eigen::Vector3d &start,
+                         const Eigen::Vector3d &dir, double t_start, double t_end) const
+  {
+    // Amanatides-Woo traversal over the blocks of this level that the sub-segment
+    // [t_start, t_end] passes, descending only into the occupied ones
+    const double block_size = double(1 << level);
+    const Eigen::Vector3i &size = level == 0 ? grid_size_ : pyramid_grid_size_[level - 1];
+    bool is_top = (level == pyramid_levels_);
+    Eigen::Vector3d entry = start + t_start * dir;
+    Eigen::Vector3i id, step;
+    Eigen::Vector3d t_max, t_delta;
+    for (int i = 0; i < 3; ++i)
+    {
+      // clamp to the children of the parent block to stay robust at block faces
+      int lo = is_top ? 0 : parent(i) * 2, hi = is_top ? size(i) - 1 : min(parent(i) * 2 + 1, size(i) - 1);
+      id(i) = max(lo, min(hi, int(floor(entry(i) / block_size))));
+      if (dir(i) > 0)
+      {
+        step(i) = 1;
+        t_delta(i) = block_size / dir(i);
+        t_max(i) = ((id(i) + 1) * block_size - start(i)) / dir(i);
+      }
+      else if (dir(i) < 0)
+      {
+        step(i) = -1;
+        t_delta(i) = -block_size / dir(i);
+        t_max(i) = (id(i) * block_size - start(i)) / dir(i);
+      }
+      else
+      {
+        step(i) = 0;
+        t_delta(i) = DBL_MAX;
+        t_max(i) = DBL_MAX;
+      }
+    }
+
+    double t = t_start;
+    while (true)
+    {
+      int axis = (t_max(0) < t_max(1)) ? (t_max(0) < t_max(2) ? 0 : 2) : (t_max(1) < t_max(2) ? 1 : 2);
+      double t_exit = min(t_max(axis), t_end);
+      if (isBlockOccupied(level, id(0), id(1), id(2)))
+      {
+        if (level == 0)
+          return false;
+        if (level == 1)
+        {
+          // the voxels inside the block are walked by the fixed-point caster on linear addresses,
+          // the same traversal the plain segment check does
+          const Eigen::Vector3d hi = grid_size_.cast<double>() - Eigen::Vector3d::Constant(1.0 / (1 << IntRayCaster::FRAC_BITS));
+          IntRayCaster raycaster;
+          raycaster.setInput((start + t * dir).cwiseMax(0.0).cwiseMin(hi), (start + t_exit * dir).cwiseMax(0.0).cwiseMin(hi),
+                             address_strides_);
+          if (!isRayFree(raycaster))
+            return false;
+        }
+        else if (!isRayFree(level - 1, id, start, dir, t, t_exit))
+          return false;
+      }
+      if (t_exit >= t_end)
+        break;
+      id(axis) += step(axis);
+      if (id(axis) < 0 || id(axis) >= size(axis))
+        break;
+      t = t_exit;
+      t_max(axis) += t_delta(axis);
+    }
+    return true;
+  }
+
+  void OccMap::occupancyToCloud()
+  {
+    glb_cloud_ptr_->points.clear();
+    for (int x = 0; x < grid_size_[0]; ++x)
+      for (int y = 0; y < grid_size_[1]; ++y)
+        for (int z = 0; z < grid_size_[2]; ++z)
+        {
+          if (isBlockOccupied(0, x, y, z) == true)
+          {
+            Eigen::Vector3d pos;
+            indexToPos(x, y, z, pos);
+            glb_cloud_ptr_->points.emplace_back(pos[0], pos[1], pos[2]);
+          }
+        }
+    glb_cloud_ptr_->width = glb_cloud_ptr_->points.size();
+    glb_cloud_ptr_->height = 1;
+    glb_cloud_ptr_->is_dense = true;
+    glb_cloud_ptr_->header.frame_id = "map";
   }
 
   void OccMap::globalOccVisCallback(const ros::TimerEvent &e)
   {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    if (local_sensing_)
+      occupancyToCloud();
     sensor_msgs::PointCloud2 cloud_msg;
     pcl::toROSMsg(*glb_cloud_ptr_, cloud_msg);
     glb_occ_pub_.publish(cloud_msg);
@@ -60,6 +481,13 @@ namespace env
     if (global_cloud.points.size() == 0)
       return;
 
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    setGlobalMap(global_cloud);
+    global_cloud_sub_.shutdown();
+  }
+
+  void OccMap::setGlobalMap(const pcl::PointCloud<pcl::PointXYZ> &global_cloud)
+  {
     pcl::PointXYZ pt;
     Eigen::Vector3d p3d;
     for (size_t i = 0; i < global_cloud.points.size(); ++i)
@@ -71,26 +499,163 @@ namespace env
       this->setOccupancy(p3d);
     }
     is_global_map_valid_ = true;
+    resetOccupancyLog();
+    occupancyToCloud();
 
-    glb_cloud_ptr_->points.clear();
-    for (int x = 0; x < grid_size_[0]; ++x)
-      for (int y = 0; y < grid_size_[1]; ++y)
-        for (int z = 0; z < grid_size_[2]; ++z)
+    cout << "glb occ set, occupancy memory: " << getMemoryUsage() << " bytes" << endl;
+  }
+
+  void OccMap::applyMapTiles(const self_msgs_and_srvs::MapTileArray &tiles)
+  {
+    pcl::PointCloud<pcl::PointXYZ> tile_cloud;
+    std::vector<int> voxels;
+    Eigen::Vector3i id;
+    Eigen::Vector3d pos;
+    const int64_t mask = (int64_t(1) << 21) - 1;
+    for (const auto &tile : tiles.tiles)
+    {
+      pcl::fromROSMsg(tile.cloud, tile_cloud);
+      voxels.clear();
+      for (const auto &pt : tile_cloud.points)
+      {
+        posToIndex(Eigen::Vector3d(pt.x, pt.y, pt.z), id);
+        if (isInMap(id))
+          voxels.push_back(idxToAddress(id));
+      }
+      std::sort(voxels.begin(), voxels.end());
+      voxels.erase(std::unique(voxels.begin(), voxels.end()), voxels.end());
+
+      // hold the new voxels before releasing the old ones, so voxels the tile keeps never turn free
+      for (int addr : voxels)
+        if (tile_refs_[addr]++ == 0)
         {
-          if (occupancy_buffer_[idxToAddress(x, y, z)] == true)
-          {
-            Eigen::Vector3d pos;
-            indexToPos(x, y, z, pos);
-            glb_cloud_ptr_->points.emplace_back(pos[0], pos[1], pos[2]);
-          }
+          addressToIdx(addr, id);
+          setOccupancy(id);
+          indexToPos(id, pos);
+          occ_log_.push_back(pos);
+          ++occ_stamp_;
         }
-    glb_cloud_ptr_->width = glb_cloud_ptr_->points.size();
-    glb_cloud_ptr_->height = 1;
-    glb_cloud_ptr_->is_dense = true;
-    glb_cloud_ptr_->header.frame_id = "map";
+      int64_t key = ((int64_t(tile.ix) & mask) << 42) | ((int64_t(tile.iy) & mask) << 21) | (int64_t(tile.iz) & mask);
+      std::vector<int> &old_voxels = tile_voxels_[key];
+      for (int addr : old_voxels)
+        if (--tile_refs_[addr] == 0)
+        {
+          addressToIdx(addr, id);
+          clearOccupancy(id);
+        }
+      if (voxels.empty())
+        tile_voxels_.erase(key);
+      else
+        old_voxels.swap(voxels);
+    }
+    if (occ_log_.size() > 65536)
+      resetOccupancyLog();
+    occupancyToCloud();
+  }
 
-    cout << "glb occ set" << endl;
-    global_cloud_sub_.shutdown();
+  void OccMap::resetMapTiles()
+  {
+    Eigen::Vector3i id;
+    for (const auto &tile : tile_voxels_)
+      for (int addr : tile.second)
+        if (--tile_refs_[addr] == 0)
+        {
+          addressToIdx(addr, id);
+          clearOccupancy(id);
+        }
+    tile_voxels_.clear();
+    map_version_ = 0;
+    is_global_map_valid_ = false;
+    resetOccupancyLog();
+    occupancyToCloud();
+    tile_fetch_timer_.start();
+  }
+
+  void OccMap::tileFetchCallback(const ros::TimerEvent &e)
+  {
+    self_msgs_and_srvs::GetMapTiles srv;
+    srv.request.min.x = min_range_(0);
+    srv.request.min.y = min_range_(1);
+    srv.request.min.z = min_range_(2);
+    srv.request.max.x = max_range_(0);
+    srv.request.max.y = max_range_(1);
+    srv.request.max.z = max_range_(2);
+    srv.request.origin.x = origin_(0);
+    srv.request.origin.y = origin_(1);
+    srv.request.origin.z = origin_(2);
+    srv.request.resolution = resolution_;
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    srv.request.since_version = map_version_;
+    if (!tile_client_.call(srv))
+    {
+      ROS_WARN("Failed to call service /get_map_tiles");
+      return;
+    }
+    // the server restarted and counts versions from scratch, the tiles held may be stale. Drop them
+    // and fetch everything on the next tick
+    if (srv.response.tiles.version < map_version_)
+    {
+      ROS_WARN("Map tile server went back from version %u to %u, fetching all tiles again", map_version_, srv.response.tiles.version);
+      resetMapTiles();
+      return;
+    }
+    // version 0, the server has no map yet
+    if (srv.response.tiles.version == 0)
+      return;
+
+    applyMapTiles(srv.response.tiles);
+    map_version_ = max(map_version_, srv.response.tiles.version);
+    tile_fetch_timer_.stop();
+    if (!is_global_map_valid_)
+    {
+      is_global_map_valid_ = true;
+      resetOccupancyLog();
+      cout << "glb occ set from " << srv.response.tiles.tiles.size() << " tiles, occupancy memory: " << getMemoryUsage() << " bytes" << endl;
+    }
+  }
+
+  void OccMap::tileUpdateCallback(const self_msgs_and_srvs::MapTileArrayConstPtr &msg)
+  {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    // before the first fetch, or already part of a fetch
+    if (!is_global_map_valid_ || msg->version == map_version_)
+      return;
+    // a late update, or the server restarted, the fetch tells which
+    if (msg->version < map_version_)
+    {
+      tile_fetch_timer_.start();
+      return;
+    }
+    // an update got lost, fetch what changed since the last one applied
+    if (msg->version > map_version_ + 1)
+    {
+      tile_fetch_timer_.start();
+      return;
+    }
+    applyMapTiles(*msg);
+    map_version_ = msg->version;
+  }
+
+  void OccMap::odomCallback(const nav_msgs::OdometryConstPtr &msg)
+  {
+    sensor_pos_(0) = msg->pose.pose.position.x;
+    sensor_pos_(1) = msg->pose.pose.position.y;
+    sensor_pos_(2) = msg->pose.pose.position.z;
+    has_odom_ = true;
+  }
+
+  void OccMap::localCloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg)
+  {
+    if (!has_odom_)
+      return;
+
+    pcl::PointCloud<pcl::PointXYZ> local_cloud;
+    pcl::fromROSMsg(*msg, local_cloud);
+    std::vector<Eigen::Vector3d> points(local_cloud.points.size());
+    for (size_t i = 0; i < local_cloud.points.size(); ++i)
+      points[i] = Eigen::Vector3d(local_cloud.points[i].x, local_cloud.points[i].y, local_cloud.points[i].z);
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    updateLocalMap(sensor_pos_, points);
   }
 
   void OccMap::init(const ros::NodeHandle &nh)
@@ -104,46 +669,105 @@ namespace env
     node_.param("occ_map/map_size_y", map_size_(1), 40.0);
     node_.param("occ_map/map_size_z", map_size_(2), 5.0);
     node_.param("occ_map/resolution", resolution_, 0.2);
+    node_.param("occ_map/pyramid_levels", pyramid_levels_, 0);
+    std::string storage_type;
+    node_.param("occ_map/storage_type", storage_type, std::string("dense"));
+    node_.param("occ_map/local_sensing", local_sensing_, false);
+    node_.param("occ_map/max_ray_length", max_ray_length_, 5.0);
+    node_.param("occ_map/recenter_margin", recenter_margin_, 2.0);
+    node_.param("occ_map/use_map_tiles", use_map_tiles_, false);
+    double p_hit, p_miss, p_min, p_max, p_occ;
+    node_.param("occ_map/p_hit", p_hit, 0.70);
+    node_.param("occ_map/p_miss", p_miss, 0.35);
+    node_.param("occ_map/p_min", p_min, 0.12);
+    node_.param("occ_map/p_max", p_max, 0.97);
+    node_.param("occ_map/p_occ", p_occ, 0.80);
+    l_hit_ = log(p_hit / (1 - p_hit));
+    l_miss_ = log(p_miss / (1 - p_miss));
+    l_min_ = log(p_min / (1 - p_min));
+    l_max_ = log(p_max / (1 - p_max));
+    l_occ_ = log(p_occ / (1 - p_occ));
     resolution_inv_ = 1 / resolution_;
 
     is_global_map_valid_ = false;
+    has_odom_ = false;
+    map_version_ = 0;
+    occ_stamp_ = 0;
+    occ_log_begin_ = 0;
 
     for (int i = 0; i < 3; ++i)
     {
       grid_size_(i) = ceil(map_size_(i) * resolution_inv_);
     }
+    ring_offset_.setZero();
+    if (local_sensing_)
+    {
+      // the rolling window scrolls by whole top level blocks of the pyramid, the level is clamped
+      // first so a too large param cannot blow up the window
+      clampPyramidLevels();
+      int block = 1 << pyramid_levels_;
+      for (int i = 0; i < 3; ++i)
+        grid_size_(i) = (grid_size_(i) + block - 1) / block * block;
+      map_size_ = grid_size_.cast<double>() * resolution_;
+    }
 
     min_range_ = origin_;
     max_range_ = origin_ + map_size_;
 
     // initialize size of buffer
     grid_size_y_multiply_z_ = grid_size_(1) * grid_size_(2);
-    int buffer_size = grid_size_(0) * grid_size_y_multiply_z_;
-    occupancy_buffer_.resize(buffer_size);
-    fill(occupancy_buffer_.begin(), occupancy_buffer_.end(), false);
+    address_strides_ = Eigen::Vector3i(grid_size_y_multiply_z_, grid_size_(2), 1);
+    occupancy_buffer_.init(grid_size_, storage_type == "block_sparse" ? OccupancyStorage::BLOCK_SPARSE : OccupancyStorage::DENSE);
+    initPyramid();
 
-    //set x-y boundary occ
-    for (double cx = min_range_[0] + resolution_ / 2; cx <= max_range_[0] - resolution_ / 2; cx += resolution_)
-      for (double cz = min_range_[2] + resolution_ / 2; cz <= max_range_[2] - resolution_ / 2; cz += resolution_)
-      {
-        this->setOccupancy(Eigen::Vector3d(cx, min_range_[1] + resolution_ / 2, cz));
-        this->setOccupancy(Eigen::Vector3d(cx, max_range_[1] - resolution_ / 2, cz));
-      }
-    for (double cy = min_range_[1] + resolution_ / 2; cy <= max_range_[1] - resolution_ / 2; cy += resolution_)
-      for (double cz = min_range_[2] + resolution_ / 2; cz <= max_range_[2] - resolution_ / 2; cz += resolution_)
-      {
-        this->setOccupancy(Eigen::Vector3d(min_range_[0] + resolution_ / 2, cy, cz));
-        this->setOccupancy(Eigen::Vector3d(max_range_[0] - resolution_ / 2, cy, cz));
-      }
-    //set z-low boundary occ
-    for (double cx = min_range_[0] + resolution_ / 2; cx <= max_range_[0] - resolution_ / 2; cx += resolution_)
+    if (local_sensing_)
+    {
+      // log-odds start at 0 (unknown), what is not observed as occupied stays free
+      int buffer_size = grid_size_(0) * grid_size_y_multiply_z_;
+      log_odds_.assign(buffer_size, 0.0f);
+      scan_flag_.assign(buffer_size, 0);
+      local_cloud_sub_ = node_.subscribe<sensor_msgs::PointCloud2>("/local_cloud", 1, &OccMap::localCloudCallback, this);
+      odom_sub_ = node_.subscribe<nav_msgs::Odometry>("/odom", 10, &OccMap::odomCallback, this);
+    }
+    else
+    {
+      //set x-y boundary occ
+      for (double cx = min_range_[0] + resolution_ / 2; cx <= max_range_[0] - resolution_ / 2; cx += resolution_)
+        for (double cz = min_range_[2] + resolution_ / 2; cz <= max_range_[2] - resolution_ / 2; cz += resolution_)
+        {
+          this->setOccupancy(Eigen::Vector3d(cx, min_range_[1] + resolution_ / 2, cz));
+          this->setOccupancy(Eigen::Vector3d(cx, max_range_[1] - resolution_ / 2, cz));
+        }
       for (double cy = min_range_[1] + resolution_ / 2; cy <= max_range_[1] - resolution_ / 2; cy += resolution_)
+        for (double cz = min_range_[2] + resolution_ / 2; cz <= max_range_[2] - resolution_ / 2; cz += resolution_)
+        {
+          this->setOccupancy(Eigen::Vector3d(min_range_[0] + resolution_ / 2, cy, cz));
+          this->setOccupancy(Eigen::Vector3d(max_range_[0] - resolution_ / 2, cy, cz));
+        }
+      //set z-low boundary occ
+      for (double cx = min_range_[0] + resolution_ / 2; cx <= max_range_[0] - resolution_ / 2; cx += resolution_)
+        for (double cy = min_range_[1] + resolution_ / 2; cy <= max_range_[1] - resolution_ / 2; cy += resolution_)
+        {
+          this->setOccupancy(Eigen::Vector3d(cx, cy, min_range_[2] + resolution_ / 2));
+        }
+      if (use_map_tiles_)
       {
-        this->setOccupancy(Eigen::Vector3d(cx, cy, min_range_[2] + resolution_ / 2));
+        // the boundary holds its voxels for good
+        tile_refs_.assign(grid_size_(0) * grid_size_y_multiply_z_, 0);
+        for (int x = 0; x < grid_size_(0); ++x)
+          for (int y = 0; y < grid_size_(1); ++y)
+            for (int z = 0; z < grid_size_(2); ++z)
+              if (isBlockOccupied(0, x, y, z))
+                tile_refs_[idxToAddress(x, y, z)] = 1;
+        tile_client_ = node_.serviceClient<self_msgs_and_srvs::GetMapTiles>("/get_map_tiles");
+        tile_update_sub_ = node_.subscribe<self_msgs_and_srvs::MapTileArray>("/map_tile_updates", 10, &OccMap::tileUpdateCallback, this);
+        tile_fetch_timer_ = node_.createTimer(ros::Duration(1), &OccMap::tileFetchCallback, this);
       }
+      else
+        global_cloud_sub_ = node_.subscribe<sensor_msgs::PointCloud2>("/global_cloud", 1, &OccMap::globalCloudCallback, this);
+    }
 
     global_occ_vis_timer_ = node_.createTimer(ros::Duration(5), &OccMap::globalOccVisCallback, this);
-    global_cloud_sub_ = node_.subscribe<sensor_msgs::PointCloud2>("/global_cloud", 1, &OccMap::globalCloudCallback, this);
     glb_occ_pub_ = node_.advertise<sensor_msgs::PointCloud2>("/occ_map/glb_map", 1);
 
     glb_cloud_ptr_ = boost::make_shared<pcl::PointCloud<pcl::PointXYZ>>();
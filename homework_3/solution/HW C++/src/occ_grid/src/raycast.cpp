@@ -364,3 +364,54 @@ bool RayCaster::step(Eigen::Vector3d& ray_pt)
 
   return true;
 }
+
+
+void IntRayCaster::setInput(const Eigen::Vector3d& start, const Eigen::Vector3d& end, const Eigen::Vector3i& strides)
+{
+  setStart(start);
+  setEnd(end, strides);
+}
+
+void IntRayCaster::setStart(const Eigen::Vector3d& start)
+{
+  for (int i = 0; i < 3; ++i)
+    start_fixed_(i) = (int64_t)std::floor(start(i) * (1 << FRAC_BITS));
+}
+
+void IntRayCaster::setEnd(const Eigen::Vector3d& end, const Eigen::Vector3i& strides)
+{
+  const int64_t one = int64_t(1) << FRAC_BITS;
+  int64_t dist[3];  // |end - start| in fixed-point units
+  int64_t next[3];  // fixed-point distance from start to the first boundary crossed
+  steps_left_ = 0;
+  addr_ = 0;
+  for (int i = 0; i < 3; ++i)
+  {
+    int64_t end_fixed = (int64_t)std::floor(end(i) * one);
+    int end_id = (int)(end_fixed >> FRAC_BITS);
+    id_(i) = (int)(start_fixed_(i) >> FRAC_BITS);
+    addr_ += (int64_t)id_(i) * strides(i);
+    dist[i] = std::abs(end_fixed - start_fixed_(i));
+    step_[i] = end_fixed > start_fixed_(i) ? 1 : (end_fixed < start_fixed_(i) ? -1 : 0);
+    addr_step_[i] = (int64_t)step_[i] * strides(i);
+    next[i] = step_[i] > 0 ? (int64_t)(id_(i) + 1) * one - start_fixed_(i) : start_fixed_(i) - (int64_t)id_(i) * one;
+    steps_left_ += std::abs(end_id - id_(i));
+  }
+
+  // t_max_[i] = next[i] / dist[i], scaled by the product of the non-zero distances
+  for (int i = 0; i < 3; ++i)
+  {
+    if (step_[i] == 0)
+    {
+      t_max_[i] = INT64_MAX;
+      t_delta_[i] = 0;
+      continue;
+    }
+    int64_t scale = 1;
+    for (int j = 0; j < 3; ++j)
+      if (j != i && step_[j] != 0)
+        scale *= dist[j];
+    t_max_[i] = next[i] * scale;
+    t_delta_[i] = one * scale;
+  }
+}
\ No newline at end of file
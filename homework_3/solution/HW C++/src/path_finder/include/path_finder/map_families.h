@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2022 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#ifndef _MAP_FAMILIES_H
+#define _MAP_FAMILIES_H
+
+#include "map_generator/random_forest.h"
+#include "maps.hpp"
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <Eigen/Eigen>
+#include <string>
+
+namespace path_plan
+{
+  /* Builds a map of one of the generator families from a seed, without their nodes: "forest" reads
+     forest/ params from nh, "perlin3d", "random", "maze2d" and "maze3d" read the mockamap params from
+     mockamap/. Returns false for an unknown type. */
+  inline bool generateMapFamily(const ros::NodeHandle &nh, const std::string &type, int seed, const Eigen::Vector3d &map_size,
+                                double resolution, pcl::PointCloud<pcl::PointXYZ> &cloud)
+  {
+    cloud.clear();
+    if (type == "forest")
+    {
+      map_gen::RandomForestParams param;
+      param.x_size = map_size(0);
+      param.y_size = map_size(1);
+      param.init_x = 0.0;
+      param.init_y = 0.0;
+      param.resolution = resolution;
+      nh.param("forest/obs_num", param.obs_num, 120);
+      nh.param("forest/circle_num", param.cir_num, 100);
+      nh.param("forest/lower_rad", param.w_l, 0.4);
+      nh.param("forest/upper_rad", param.w_h, 2.5);
+      nh.param("forest/lower_hei", param.h_l, 0.5);
+      nh.param("forest/upper_hei", param.h_h, 7.5);
+      nh.param("forest/lower_circle_rad", param.w_c_l, 0.9);
+      nh.param("forest/upper_circle_rad", param.w_c_h, 3.2);
+      map_gen::generateRandomForest(param, seed, cloud);
+      return true;
+    }
+
+    int mocka_type;
+    if (type == "perlin3d")
+      mocka_type = 1;
+    else if (type == "random")
+      mocka_type = 2;
+    else if (type == "maze2d")
+      mocka_type = 3;
+    else if (type == "maze3d")
+      mocka_type = 4;
+    else
+    {
+      ROS_ERROR_STREAM("unknown map type: " << type);
+      return false;
+    }
+    ros::NodeHandle mocka_nh(nh, "mockamap");
+    sensor_msgs::PointCloud2 output;
+    mocka::Maps::BasicInfo info;
+    info.nh_private = &mocka_nh;
+    info.scale = 1 / resolution;
+    info.sizeX = map_size(0) * info.scale;
+    info.sizeY = map_size(1) * info.scale;
+    info.sizeZ = map_size(2) * info.scale;
+    info.seed = seed;
+    info.output = &output;
+    info.cloud = &cloud;
+    mocka::Maps map;
+    map.setInfo(info);
+    map.generate(mocka_type);
+    return true;
+  }
+
+} // namespace path_plan
+
+#endif
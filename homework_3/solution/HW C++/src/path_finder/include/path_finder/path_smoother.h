@@ -0,0 +1,406 @@
+/*
+Copyright (C) 2022 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#ifndef PATH_SMOOTHER_H
+#define PATH_SMOOTHER_H
+
+#include "occ_grid/occ_map.h"
+#include "sampler.h"
+#include "scope_trace/scope_trace.hpp"
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace path_plan
+{
+  /* Post-processing of a collision-free waypoint path, e.g. from RRTStar::getPath():
+     shortcutting (greedy or random) and then a uniform cubic B-spline through the shortcut path. All
+     collision checks go through a batched segment checker and are spread over OpenMP threads. */
+  class PathSmoother
+  {
+  public:
+    // valid[i] tells whether the segment p0 -> p1s[i] is collision free, see OccMap::areSegmentsValid
+    typedef std::function<void(const Eigen::Vector3d &, const vector<Eigen::Vector3d> &, vector<bool> &)> BatchChecker;
+
+    PathSmoother(){};
+    PathSmoother(const ros::NodeHandle &nh, const env::OccMap::Ptr &mapPtr) : nh_(nh)
+    {
+      env::OccMap::Ptr map_ptr = mapPtr;
+      init([map_ptr](const Eigen::Vector3d &p0, const vector<Eigen::Vector3d> &p1s, vector<bool> &valid)
+           { map_ptr->areSegmentsValid(p0, p1s, valid); });
+    }
+    // for paths on maps other than OccMap, the checker only has to answer segments from a shared start
+    PathSmoother(const ros::NodeHandle &nh, const BatchChecker &checker) : nh_(nh)
+    {
+      init(checker);
+    }
+    ~PathSmoother(){};
+
+    /* shortcut then smooth, falls back to the shortcut path if no collision-free curve is found */
+    bool process(const vector<Eigen::Vector3d> &path, vector<Eigen::Vector3d> &smoothed)
+    {
+      SCOPE_TRACE_ZONE("PathSmoother::process");
+      collision_check_nums_ = 0;
+      if (shortcut_method_ == "random")
+        shortcutRandom(path, shortcut_path_);
+      else if (shortcut_method_ == "greedy")
+        shortcutGreedy(path, shortcut_path_);
+      else
+        shortcut_path_ = path;
+
+      if (!use_bspline_ || shortcut_path_.size() < 3)
+      {
+        ctrl_pts_ = shortcut_path_;
+        smoothed = shortcut_path_;
+        return true;
+      }
+      if (fitBSpline(shortcut_path_, smoothed))
+        return true;
+      ROS_WARN("[PathSmoother]: no collision-free B-spline, keep the shortcut path");
+      ctrl_pts_ = shortcut_path_;
+      smoothed = shortcut_path_;
+      return false;
+    }
+
+    /* from each waypoint jump to the farthest later waypoint it sees, one batched check per waypoint */
+    void shortcutGreedy(const vector<Eigen::Vector3d> &path, vector<Eigen::Vector3d> &shortcut)
+    {
+      SCOPE_TRACE_ZONE("shortcutGreedy");
+      shortcut.clear();
+      if (path.empty())
+        return;
+      shortcut.push_back(path[0]);
+      size_t i = 0;
+      while (i + 1 < path.size())
+      {
+        vector<Eigen::Vector3d> targets(path.begin() + i + 1, path.end());
+        vector<bool> valid;
+        checkFromPoint(path[i], targets, valid);
+        size_t next = i + 1; // the path edge itself is taken as valid
+        for (size_t k = targets.size(); k-- > 1;)
+        {
+          if (valid[k])
+          {
+            next = i + 1 + k;
+            break;
+          }
+        }
+        shortcut.push_back(path[next]);
+        i = next;
+      }
+    }
+
+    /* each round draws random pairs of points anywhere along the path, checks them in parallel and
+       applies the non-overlapping valid ones, longest saving first */
+    void shortcutRandom(const vector<Eigen::Vector3d> &path, vector<Eigen::Vector3d> &shortcut)
+    {
+      SCOPE_TRACE_ZONE("shortcutRandom");
+      shortcut = path;
+      for (int round = 0; round < random_shortcut_rounds_ && shortcut.size() > 2; ++round)
+      {
+        vector<double> arc_len;
+        accumulateLength(shortcut, arc_len);
+        double total_len = arc_len.back();
+        if (total_len <= 0.0)
+          break;
+
+        vector<Shortcut> candidates(random_shortcut_pairs_);
+        vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> segments(random_shortcut_pairs_);
+        for (int k = 0; k < random_shortcut_pairs_; ++k)
+        {
+          Shortcut &c = candidates[k];
+          c.s0 = sampler_.getUniRandNum() * total_len;
+          c.s1 = sampler_.getUniRandNum() * total_len;
+          if (c.s0 > c.s1)
+            std::swap(c.s0, c.s1);
+          c.p0 = pointAt(shortcut, arc_len, c.s0);
+          c.p1 = pointAt(shortcut, arc_len, c.s1);
+          c.gain = (c.s1 - c.s0) - (c.p1 - c.p0).norm();
+          segments[k] = std::make_pair(c.p0, c.p1);
+        }
+        vector<char> valid;
+        checkSegments(segments, valid);
+
+        vector<Shortcut> accepted;
+        for (int k = 0; k < random_shortcut_pairs_; ++k)
+          if (valid[k] && candidates[k].gain > min_shortcut_gain_)
+            accepted.push_back(candidates[k]);
+        std::sort(accepted.begin(), accepted.end(), [](const Shortcut &a, const Shortcut &b)
+                  { return a.gain > b.gain; });
+        vector<Shortcut> applied;
+        for (const auto &c : accepted)
+        {
+          bool overlap = false;
+          for (const auto &a : applied)
+            overlap |= c.s0 < a.s1 && a.s0 < c.s1;
+          if (!overlap)
+            applied.push_back(c);
+        }
+        if (applied.empty())
+          continue;
+        std::sort(applied.begin(), applied.end(), [](const Shortcut &a, const Shortcut &b)
+                  { return a.s0 < b.s0; });
+
+        // drop the waypoints strictly inside a shortcut, put its end points in their place
+        vector<Eigen::Vector3d> next_path;
+        size_t a = 0;
+        for (size_t i = 0; i < shortcut.size(); ++i)
+        {
+          while (a < applied.size() && applied[a].s1 <= arc_len[i])
+          {
+            appendPoint(applied[a].p0, next_path);
+            appendPoint(applied[a].p1, next_path);
+            ++a;
+          }
+          if (a < applied.size() && applied[a].s0 < arc_len[i] && arc_len[i] < applied[a].s1)
+            continue;
+          appendPoint(shortcut[i], next_path);
+        }
+        for (; a < applied.size(); ++a)
+        {
+          appendPoint(applied[a].p0, next_path);
+          appendPoint(applied[a].p1, next_path);
+        }
+        shortcut.swap(next_path);
+      }
+    }
+
+    /* Uniform cubic B-spline, control points are the path resampled every bspline_interval_ with the end
+       points tripled so the curve is clamped to them. A span that collides gets its control points
+       tripled too: next to a tripled control point the curve runs along the control polygon, which is
+       the collision-free path itself. */
+    bool fitBSpline(const vector<Eigen::Vector3d> &path, vector<Eigen::Vector3d> &curve)
+    {
+      SCOPE_TRACE_ZONE("fitBSpline");
+      vector<Eigen::Vector3d> pts;
+      for (size_t i = 0; i + 1 < path.size(); ++i)
+      {
+        int n = std::max(1, (int)std::ceil((path[i + 1] - path[i]).norm() / bspline_interval_));
+        for (int k = 0; k < n; ++k)
+          pts.push_back(path[i] + (path[i + 1] - path[i]) * (double(k) / n));
+      }
+      pts.push_back(path.back());
+      vector<int> multiplicity(pts.size(), 1);
+      multiplicity.front() = 3;
+      multiplicity.back() = 3;
+
+      for (int iter = 0; iter < bspline_max_iterations_; ++iter)
+      {
+        // control points with their multiplicity, pts_id maps them back to pts
+        ctrl_pts_.clear();
+        vector<int> pts_id;
+        for (size_t i = 0; i < pts.size(); ++i)
+        {
+          for (int m = 0; m < multiplicity[i]; ++m)
+          {
+            ctrl_pts_.push_back(pts[i]);
+            pts_id.push_back(i);
+          }
+        }
+
+        // sample every span densely enough for the collision check and remember which span a sample is in
+        curve.clear();
+        vector<int> span_of_sample;
+        for (size_t j = 0; j + 3 < ctrl_pts_.size(); ++j)
+        {
+          double span_len = (ctrl_pts_[j + 2] - ctrl_pts_[j + 1]).norm() + (ctrl_pts_[j + 3] - ctrl_pts_[j]).norm() / 3.0;
+          int n = std::max(1, (int)std::ceil(span_len / sample_step_));
+          for (int k = 0; k < n; ++k)
+          {
+            appendPoint(evaluateSpan(j, double(k) / n), curve);
+            span_of_sample.push_back(j);
+          }
+        }
+        appendPoint(ctrl_pts_.back(), curve);
+        span_of_sample.push_back(ctrl_pts_.size() - 4);
+
+        vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> segments(curve.size() - 1);
+        for (size_t k = 0; k + 1 < curve.size(); ++k)
+          segments[k] = std::make_pair(curve[k], curve[k + 1]);
+        vector<char> valid;
+        checkSegments(segments, valid);
+
+        bool pinned = false, collided = false;
+        for (size_t k = 0; k < segments.size(); ++k)
+        {
+          if (valid[k])
+            continue;
+          collided = true;
+          int j = span_of_sample[k];
+          for (int c = j; c < j + 4; ++c)
+          {
+            if (multiplicity[pts_id[c]] < 3)
+            {
+              multiplicity[pts_id[c]] = 3;
+              pinned = true;
+            }
+          }
+        }
+        if (!collided)
+          return true;
+        if (!pinned)
+          return false;
+      }
+      return false;
+    }
+
+    // the path before B-spline fitting
+    vector<Eigen::Vector3d> getShortcutPath() { return shortcut_path_; }
+    // control points of the uniform cubic B-spline, repeated ones included
+    vector<Eigen::Vector3d> getControlPoints() { return ctrl_pts_; }
+    size_t getCollisionCheckNums() { return collision_check_nums_; }
+
+    static double pathLength(const vector<Eigen::Vector3d> &path)
+    {
+      double len = 0.0;
+      for (size_t i = 1; i < path.size(); ++i)
+        len += (path[i] - path[i - 1]).norm();
+      return len;
+    }
+
+  private:
+    ros::NodeHandle nh_;
+    BatchChecker checker_;
+    BiasSampler sampler_;
+
+    std::string shortcut_method_;
+    int random_shortcut_rounds_;
+    int random_shortcut_pairs_;
+    double min_shortcut_gain_;
+    bool use_bspline_;
+    double bspline_interval_;
+    double sample_step_;
+    int bspline_max_iterations_;
+    int seed_;
+
+    vector<Eigen::Vector3d> shortcut_path_;
+    vector<Eigen::Vector3d> ctrl_pts_;
+    size_t collision_check_nums_;
+
+    struct Shortcut
+    {
+      double s0, s1, gain;
+      Eigen::Vector3d p0, p1;
+    };
+
+    void init(const BatchChecker &checker)
+    {
+      checker_ = checker;
+      nh_.param("PathSmoother/shortcut", shortcut_method_, std::string("greedy"));
+      nh_.param("PathSmoother/random_shortcut_rounds", random_shortcut_rounds_, 20);
+      nh_.param("PathSmoother/random_shortcut_pairs", random_shortcut_pairs_, 32);
+      nh_.param("PathSmoother/min_shortcut_gain", min_shortcut_gain_, 0.01);
+      nh_.param("PathSmoother/use_bspline", use_bspline_, true);
+      nh_.param("PathSmoother/bspline_interval", bspline_interval_, 1.0);
+      nh_.param("PathSmoother/sample_step", sample_step_, 0.1);
+      nh_.param("PathSmoother/bspline_max_iterations", bspline_max_iterations_, 10);
+      nh_.param("PathSmoother/seed", seed_, -1);
+      ROS_WARN_STREAM("[PathSmoother] param: shortcut: " << shortcut_method_);
+      ROS_WARN_STREAM("[PathSmoother] param: use_bspline: " << use_bspline_);
+      ROS_WARN_STREAM("[PathSmoother] param: bspline_interval: " << bspline_interval_);
+      if (seed_ >= 0)
+        sampler_.setSeed(seed_);
+      collision_check_nums_ = 0;
+    }
+
+    /* the targets are split over the threads, each thread runs one batched check from p0 */
+    void checkFromPoint(const Eigen::Vector3d &p0, const vector<Eigen::Vector3d> &p1s, vector<bool> &valid)
+    {
+      collision_check_nums_ += p1s.size();
+      int chunk_num = 1;
+#ifdef _OPENMP
+      chunk_num = std::min<int>(omp_get_max_threads(), p1s.size() / 8 + 1);
+#endif
+      if (chunk_num <= 1)
+      {
+        checker_(p0, p1s, valid);
+        return;
+      }
+      vector<vector<bool>> chunk_valid(chunk_num);
+      size_t chunk_size = (p1s.size() + chunk_num - 1) / chunk_num;
+#pragma omp parallel for schedule(static, 1)
+      for (int c = 0; c < chunk_num; ++c)
+      {
+        size_t begin = std::min(p1s.size(), c * chunk_size), end = std::min(p1s.size(), begin + chunk_size);
+        vector<Eigen::Vector3d> part(p1s.begin() + begin, p1s.begin() + end);
+        checker_(p0, part, chunk_valid[c]);
+      }
+      valid.clear();
+      for (const auto &v : chunk_valid)
+        valid.insert(valid.end(), v.begin(), v.end());
+    }
+
+    /* segments with different start points, checked one per call in parallel */
+    void checkSegments(const vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> &segments, vector<char> &valid)
+    {
+      collision_check_nums_ += segments.size();
+      valid.assign(segments.size(), 0);
+#pragma omp parallel for schedule(dynamic, 16)
+      for (int k = 0; k < (int)segments.size(); ++k)
+      {
+        vector<Eigen::Vector3d> p1s(1, segments[k].second);
+        vector<bool> v;
+        checker_(segments[k].first, p1s, v);
+        valid[k] = v[0];
+      }
+    }
+
+    Eigen::Vector3d evaluateSpan(size_t j, double u) const
+    {
+      double u2 = u * u, u3 = u2 * u, v = 1.0 - u;
+      return (v * v * v * ctrl_pts_[j] + (3.0 * u3 - 6.0 * u2 + 4.0) * ctrl_pts_[j + 1] +
+              (-3.0 * u3 + 3.0 * u2 + 3.0 * u + 1.0) * ctrl_pts_[j + 2] + u3 * ctrl_pts_[j + 3]) /
+             6.0;
+    }
+
+    static void accumulateLength(const vector<Eigen::Vector3d> &path, vector<double> &arc_len)
+    {
+      arc_len.assign(path.size(), 0.0);
+      for (size_t i = 1; i < path.size(); ++i)
+        arc_len[i] = arc_len[i - 1] + (path[i] - path[i - 1]).norm();
+    }
+
+    static Eigen::Vector3d pointAt(const vector<Eigen::Vector3d> &path, const vector<double> &arc_len, double s)
+    {
+      size_t i = std::upper_bound(arc_len.begin(), arc_len.end(), s) - arc_len.begin();
+      if (i == 0)
+        return path.front();
+      if (i >= path.size())
+        return path.back();
+      double seg_len = arc_len[i] - arc_len[i - 1];
+      return seg_len > 0.0 ? Eigen::Vector3d(path[i - 1] + (path[i] - path[i - 1]) * ((s - arc_len[i - 1]) / seg_len)) : path[i];
+    }
+
+    static void appendPoint(const Eigen::Vector3d &p, vector<Eigen::Vector3d> &path)
+    {
+      if (path.empty() || (path.back() - p).squaredNorm() > 1e-12)
+        path.push_back(p);
+    }
+  };
+
+} // namespace path_plan
+
+#endif
@@ -22,17 +22,24 @@ OF SUCH DAMAGE.
 #define RRT_STAR_H
 
 #include "occ_grid/occ_map.h"
+#include "occ_grid/segment_cache.h"
 #include "visualization/visualization.hpp"
+#include "tree_publisher.h"
 #include "sampler.h"
 #include "node.h"
 #include "kdtree.h"
+#include "scope_trace/scope_trace.hpp"
 
 #include <ros/ros.h>
 #include <utility>
 #include <queue>
+#include <unordered_set>
+#include <memory>
 
 namespace path_plan
 {
+  typedef std::unique_ptr<kdtree, void (*)(kdtree *)> KdTreePtr;
+
   class RRTStar
   {
   public:
@@ -43,25 +50,61 @@ namespace path_plan
       nh_.param("RRT_Star/search_radius", search_radius_, 0.0);
       nh_.param("RRT_Star/search_time", search_time_, 0.0);
       nh_.param("RRT_Star/max_tree_node_nums", max_tree_node_nums_, 0);
+      nh_.param("RRT_Star/use_segment_cache", use_segment_cache_, false);
+      nh_.param("RRT_Star/bidirectional", bidirectional_, false);
+      nh_.param("RRT_Star/reuse_tree", reuse_tree_, false);
+      nh_.param("RRT_Star/seed", seed_, -1);
+      nh_.param("RRT_Star/max_iterations", max_iterations_, 0);
+      nh_.param("RRT_Star/tree_vis_rate", tree_vis_rate_, 2.0);
       ROS_WARN_STREAM("[RRT*] param: steer_length: " << steer_length_);
       ROS_WARN_STREAM("[RRT*] param: search_radius: " << search_radius_);
       ROS_WARN_STREAM("[RRT*] param: search_time: " << search_time_);
       ROS_WARN_STREAM("[RRT*] param: max_tree_node_nums: " << max_tree_node_nums_);
+      ROS_WARN_STREAM("[RRT*] param: use_segment_cache: " << use_segment_cache_);
+      ROS_WARN_STREAM("[RRT*] param: bidirectional: " << bidirectional_);
+      ROS_WARN_STREAM("[RRT*] param: reuse_tree: " << reuse_tree_);
+      ROS_WARN_STREAM("[RRT*] param: seed: " << seed_);
+      ROS_WARN_STREAM("[RRT*] param: max_iterations: " << max_iterations_);
 
-      sampler_.setSamplingRange(mapPtr->getOrigin(), mapPtr->getMapSize());
+      setSeed(seed_);
 
       valid_tree_node_nums_ = 0;
+      sample_nums_ = 0;
+      reuse_iterations_ = 0;
+      collision_check_nums_ = 0;
+      has_tree_ = false;
+      map_stamp_ = 0;
       nodes_pool_.resize(max_tree_node_nums_);
       for (int i = 0; i < max_tree_node_nums_; ++i)
       {
         nodes_pool_[i] = new TreeNode;
       }
     }
-    ~RRTStar(){};
+    ~RRTStar()
+    {
+      for (auto &node : nodes_pool_)
+        delete node;
+    };
+    RRTStar(const RRTStar &) = delete;
+    RRTStar &operator=(const RRTStar &) = delete;
 
     bool plan(const Eigen::Vector3d &s, const Eigen::Vector3d &g)
     {
+      SCOPE_TRACE_ZONE("RRTStar::plan");
+      plan_start_time_ = ros::Time::now();
+      // a local sensing map scrolls with the sensor, sample the window it covers now
+      sampler_.setSamplingRange(map_ptr_->getOrigin(), map_ptr_->getMapSize());
+      /* keep the tree of the last query if it leaves room to grow */
+      if (reuse_tree_ && !bidirectional_ && has_tree_ && valid_tree_node_nums_ < max_tree_node_nums_ * 3 / 4 &&
+          map_ptr_->isStateValid(s) && map_ptr_->isStateValid(g) && reuseTree(s, g))
+      {
+        ROS_INFO("[RRT*]: RRT continues from the last tree");
+        map_stamp_ = map_ptr_->getOccupancyStamp();
+        return rrt_star(s, g);
+      }
+
       reset();
+      setSeed(seed_);
       if (!map_ptr_->isStateValid(s))
       {
         ROS_ERROR("[RRT*]: Start pos collide or out of bound");
@@ -81,6 +124,17 @@ namespace path_plan
       goal_node_->cost_from_start = DBL_MAX; // important
       valid_tree_node_nums_ = 2;             // put start and goal in tree
       ROS_INFO("[RRT*]: RRT starts planning a path");
+      if (bidirectional_)
+      {
+        has_tree_ = false;
+        return brrt_star(s, g);
+      }
+      /* kd tree init */
+      kd_tree_.reset(kd_create(3));
+      //Add start and goal nodes to kd tree
+      kd_insert3(kd_tree_.get(), start_node_->x[0], start_node_->x[1], start_node_->x[2], start_node_);
+      has_tree_ = true;
+      map_stamp_ = map_ptr_->getOccupancyStamp();
       return rrt_star(s, g);
     }
 
@@ -99,9 +153,41 @@ namespace path_plan
       return solution_cost_time_pair_list_;
     }
 
+    // statistics of the last plan() call
+    int getSampleNums() { return sample_nums_; }
+    size_t getCollisionCheckNums() { return collision_check_nums_; }
+    int getTreeNodeNums() { return valid_tree_node_nums_; }
+
+    void setBidirectional(bool bidirectional)
+    {
+      bidirectional_ = bidirectional;
+    }
+
+    void setReuseTree(bool reuse_tree)
+    {
+      reuse_tree_ = reuse_tree;
+    }
+
+    // restarts the sample sequence, the same queries then give the same trees. seed < 0 keeps the
+    // std::random_device seed. Every plan() that builds a new tree restarts the sequence, one that
+    // continues a reused tree does not, it would get the same samples again
+    void setSeed(int seed)
+    {
+      seed_ = seed;
+      if (seed_ >= 0)
+        sampler_.setSeed(seed_);
+    }
+
+    // max_iterations <= 0 leaves only the time budget
+    void setMaxIterations(int max_iterations)
+    {
+      max_iterations_ = max_iterations;
+    }
+
     void setVisualizer(const std::shared_ptr<visualization::Visualization> &visPtr)
     {
       vis_ptr_ = visPtr;
+      tree_publisher_.reset(new TreePublisher(nh_, tree_vis_rate_));
     };
 
   private:
@@ -114,11 +200,23 @@ namespace path_plan
     double search_radius_;
     double search_time_;
     int max_tree_node_nums_;
+    bool use_segment_cache_;
+    bool bidirectional_;
+    bool reuse_tree_;
+    int seed_;
+    int max_iterations_;
     int valid_tree_node_nums_;
+    int sample_nums_;
+    int reuse_iterations_; // part of max_iterations_ the rewiring cascade of reuseTree() used
+    size_t collision_check_nums_;
     double first_path_use_time_;
     double final_path_use_time_;
 
     std::vector<TreeNode *> nodes_pool_;
+    KdTreePtr kd_tree_{nullptr, kd_free}; // the tree of rrt_star(), kept across plan() calls when reusing
+    bool has_tree_;
+    size_t map_stamp_; // map occupancy stamp the tree was checked against
+    ros::Time plan_start_time_;
     TreeNode *start_node_;
     TreeNode *goal_node_;
     vector<Eigen::Vector3d> final_path_;
@@ -127,19 +225,89 @@ namespace path_plan
 
     // environment
     env::OccMap::Ptr map_ptr_;
+    env::SegmentCache segment_cache_;
     std::shared_ptr<visualization::Visualization> vis_ptr_;
+    std::unique_ptr<TreePublisher> tree_publisher_;
+    double tree_vis_rate_;
+
+    /* the search stops on whichever of max_iterations_ and search_time_ runs out first. With an iteration
+       budget and search_time_ <= 0 the clock is ignored, so a seeded run is exactly reproducible. A reused
+       tree counts the pops of its rewiring cascade as iterations too */
+    bool withinBudget(int iter, double time_budget) const
+    {
+      if (max_iterations_ > 0 && iter >= max_iterations_)
+        return false;
+      if (max_iterations_ > 0 && search_time_ <= 0.0)
+        return true;
+      return (ros::Time::now() - plan_start_time_).toSec() < time_budget;
+    }
 
     void reset()
     {
       final_path_.clear();
       path_list_.clear();
       solution_cost_time_pair_list_.clear();
+      segment_cache_.clear();
+      sample_nums_ = 0;
+      reuse_iterations_ = 0;
+      collision_check_nums_ = 0;
       for (int i = 0; i < valid_tree_node_nums_; i++)
       {
         nodes_pool_[i]->parent = nullptr;
         nodes_pool_[i]->children.clear();
       }
       valid_tree_node_nums_ = 0;
+      // the kd tree indexes the nodes just unlinked, a query rejected before the next tree is built must not reuse it
+      kd_tree_.reset();
+      has_tree_ = false;
+    }
+
+    bool isSegmentValid(const Eigen::Vector3d &p0, const Eigen::Vector3d &p1)
+    {
+      ++collision_check_nums_;
+      if (!use_segment_cache_)
+        return map_ptr_->isSegmentValid(p0, p1);
+      bool valid;
+      if (segment_cache_.query(p0, p1, valid))
+        return valid;
+      valid = map_ptr_->isSegmentValid(p0, p1);
+      segment_cache_.insert(p0, p1, valid);
+      return valid;
+    }
+
+    /* edges from p0 to each of p1s, the cached ones are answered from the cache and only the misses go
+       to the map in one batch */
+    void areSegmentsValid(const Eigen::Vector3d &p0, const vector<Eigen::Vector3d> &p1s, vector<bool> &valid)
+    {
+      collision_check_nums_ += p1s.size();
+      if (!use_segment_cache_)
+      {
+        map_ptr_->areSegmentsValid(p0, p1s, valid);
+        return;
+      }
+      valid.resize(p1s.size());
+      vector<size_t> miss_ids;
+      vector<Eigen::Vector3d> miss_pts;
+      for (size_t i = 0; i < p1s.size(); ++i)
+      {
+        bool v;
+        if (segment_cache_.query(p0, p1s[i], v))
+          valid[i] = v;
+        else
+        {
+          miss_ids.push_back(i);
+          miss_pts.push_back(p1s[i]);
+        }
+      }
+      if (miss_pts.empty())
+        return;
+      vector<bool> miss_valid;
+      map_ptr_->areSegmentsValid(p0, miss_pts, miss_valid);
+      for (size_t j = 0; j < miss_ids.size(); ++j)
+      {
+        valid[miss_ids[j]] = miss_valid[j];
+        segment_cache_.insert(p0, miss_pts[j], miss_valid[j]);
+      }
     }
 
     double calDist(const Eigen::Vector3d &p1, const Eigen::Vector3d &p2)
@@ -195,6 +363,27 @@ namespace path_plan
       }
     }
 
+    /* hand the tree to the publisher thread, rate limited unless forced. Walks the pool instead of the tree,
+       so both trees of brrt_star() are included */
+    void publishTree(bool force)
+    {
+      if (!tree_publisher_ || !tree_publisher_->wantSnapshot(force))
+        return;
+      vector<Eigen::Vector3d> vertice;
+      vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> edges;
+      vertice.reserve(valid_tree_node_nums_);
+      edges.reserve(valid_tree_node_nums_);
+      for (int i = 0; i < valid_tree_node_nums_; ++i)
+      {
+        const RRTNode3DPtr &node = nodes_pool_[i];
+        if (node->parent == nullptr)
+          continue;
+        vertice.push_back(node->x);
+        edges.emplace_back(node->parent->x, node->x);
+      }
+      tree_publisher_->publish(vertice, edges);
+    }
+
     void fillPath(const RRTNode3DPtr &n, vector<Eigen::Vector3d> &path)
     {
       path.clear();
@@ -208,20 +397,406 @@ namespace path_plan
       std::reverse(std::begin(path), std::end(path));
     }
 
-    bool rrt_star(const Eigen::Vector3d &s, const Eigen::Vector3d &g)
+    // path through a connection of the start tree and the goal tree
+    void fillPath(const RRTNode3DPtr &start_side, const RRTNode3DPtr &goal_side, vector<Eigen::Vector3d> &path)
+    {
+      fillPath(start_side, path);
+      for (RRTNode3DPtr node_ptr = goal_side; node_ptr; node_ptr = node_ptr->parent)
+      {
+        if ((node_ptr->x - path.back()).squaredNorm() > 1e-12)
+          path.push_back(node_ptr->x);
+      }
+    }
+
+    /* one RRT* extension of the tree in kd_tree towards x_target: steer from the nearest node, choose the
+       cheapest collision free parent among the neighbours and rewire them through the new node */
+    RRTNode3DPtr growTree(kdtree *kd_tree, const Eigen::Vector3d &x_target)
+    {
+      if (valid_tree_node_nums_ >= max_tree_node_nums_)
+        return nullptr;
+
+      struct kdres *p_nearest = kd_nearest3(kd_tree, x_target[0], x_target[1], x_target[2]);
+      if (p_nearest == nullptr)
+      {
+        ROS_ERROR("nearest query error");
+        return nullptr;
+      }
+      RRTNode3DPtr nearest_node = (RRTNode3DPtr)kd_res_item_data(p_nearest);
+      kd_res_free(p_nearest);
+
+      Eigen::Vector3d x_new = steer(nearest_node->x, x_target, steer_length_);
+      if (!isSegmentValid(nearest_node->x, x_new))
+        return nullptr;
+
+      vector<RRTNode3DPtr> neighbour_nodes;
+      struct kdres *nbr_set = kd_nearest_range3(kd_tree, x_new[0], x_new[1], x_new[2], search_radius_);
+      if (nbr_set == nullptr)
+      {
+        ROS_ERROR("bkwd kd range query error");
+        return nullptr;
+      }
+      while (!kd_res_end(nbr_set))
+      {
+        neighbour_nodes.emplace_back((RRTNode3DPtr)kd_res_item_data(nbr_set));
+        kd_res_next(nbr_set);
+      }
+      kd_res_free(nbr_set);
+
+      vector<Eigen::Vector3d> neighbour_pts(neighbour_nodes.size());
+      for (size_t i = 0; i < neighbour_nodes.size(); ++i)
+        neighbour_pts[i] = neighbour_nodes[i]->x;
+      vector<bool> neighbour_valid;
+      areSegmentsValid(x_new, neighbour_pts, neighbour_valid);
+
+      /* choose parent */
+      double cost_from_p = calDist(nearest_node->x, x_new);
+      double min_dist_from_start = nearest_node->cost_from_start + cost_from_p;
+      RRTNode3DPtr min_node(nearest_node);
+      for (size_t i = 0; i < neighbour_nodes.size(); ++i)
+      {
+        if (!neighbour_valid[i])
+          continue;
+        double dist = calDist(neighbour_nodes[i]->x, x_new);
+        if (neighbour_nodes[i]->cost_from_start + dist < min_dist_from_start)
+        {
+          min_dist_from_start = neighbour_nodes[i]->cost_from_start + dist;
+          cost_from_p = dist;
+          min_node = neighbour_nodes[i];
+        }
+      }
+      RRTNode3DPtr new_node = addTreeNode(min_node, x_new, min_dist_from_start, cost_from_p);
+      kd_insert3(kd_tree, x_new[0], x_new[1], x_new[2], new_node);
+
+      /* rewire */
+      for (size_t i = 0; i < neighbour_nodes.size(); ++i)
+      {
+        if (!neighbour_valid[i])
+          continue;
+        double dist = calDist(new_node->x, neighbour_nodes[i]->x);
+        if (neighbour_nodes[i]->cost_from_start > new_node->cost_from_start + dist)
+          changeNodeParent(neighbour_nodes[i], new_node, dist);
+      }
+      return new_node;
+    }
+
+    /* bidirectional RRT*: a start tree and a goal tree take turns growing towards the sample, the other
+       one then greedily extends towards the new node as in RRT-Connect. In the goal tree cost_from_start
+       is the cost to the goal. */
+    bool brrt_star(const Eigen::Vector3d &s, const Eigen::Vector3d &g)
     {
-      ros::Time rrt_start_time = ros::Time::now();
+      SCOPE_TRACE_ZONE("BRRT*");
+      ros::Time rrt_start_time = plan_start_time_;
       bool goal_found = false;
+      double best_cost = DBL_MAX;
 
-      /* kd tree init */
-      kdtree *kd_tree = kd_create(3);
-      //Add start and goal nodes to kd tree
-      kd_insert3(kd_tree, start_node_->x[0], start_node_->x[1], start_node_->x[2], start_node_);
+      goal_node_->cost_from_start = 0.0; // root of the goal tree
+      KdTreePtr start_tree(kd_create(3), kd_free);
+      KdTreePtr goal_tree(kd_create(3), kd_free);
+      kd_insert3(start_tree.get(), start_node_->x[0], start_node_->x[1], start_node_->x[2], start_node_);
+      kd_insert3(goal_tree.get(), goal_node_->x[0], goal_node_->x[1], goal_node_->x[2], goal_node_);
+
+      // (start tree node, goal tree node) pairs at the same position
+      vector<std::pair<RRTNode3DPtr, RRTNode3DPtr>> connections;
+      bool grow_start_tree = true;
+      int idx = 0;
+      for (idx = 0; withinBudget(idx, search_time_) && valid_tree_node_nums_ < max_tree_node_nums_; ++idx)
+      {
+        publishTree(false);
+        Eigen::Vector3d x_rand;
+        if (goal_found)
+          sampler_.samplingOnceInEllipse(x_rand, best_cost, s, g);
+        else
+          sampler_.samplingOnce(x_rand);
+        if (!map_ptr_->isStateValid(x_rand))
+          continue;
+
+        kdtree *tree_a = grow_start_tree ? start_tree.get() : goal_tree.get();
+        kdtree *tree_b = grow_start_tree ? goal_tree.get() : start_tree.get();
+        RRTNode3DPtr new_a = growTree(tree_a, x_rand);
+        if (new_a == nullptr)
+        {
+          grow_start_tree = !grow_start_tree;
+          continue;
+        }
+
+        /* greedy connect, extend tree b towards the new node until blocked or reached */
+        RRTNode3DPtr new_b = nullptr;
+        while ((new_b = growTree(tree_b, new_a->x)) != nullptr)
+        {
+          if ((new_b->x - new_a->x).squaredNorm() < 1e-12)
+          {
+            if (grow_start_tree)
+              connections.emplace_back(new_a, new_b);
+            else
+              connections.emplace_back(new_b, new_a);
+            break;
+          }
+        }
+        grow_start_tree = !grow_start_tree;
+
+        /* rewiring may have lowered the cost of earlier connections too */
+        RRTNode3DPtr best_start_side = nullptr, best_goal_side = nullptr;
+        double curr_best_cost = best_cost;
+        for (const auto &conn : connections)
+        {
+          double cost = conn.first->cost_from_start + conn.second->cost_from_start;
+          if (cost < curr_best_cost)
+          {
+            curr_best_cost = cost;
+            best_start_side = conn.first;
+            best_goal_side = conn.second;
+          }
+        }
+        if (best_start_side)
+        {
+          if (!goal_found)
+          {
+            first_path_use_time_ = (ros::Time::now() - rrt_start_time).toSec();
+          }
+          goal_found = true;
+          best_cost = curr_best_cost;
+          fillPath(best_start_side, best_goal_side, final_path_);
+          path_list_.emplace_back(final_path_);
+          solution_cost_time_pair_list_.emplace_back(best_cost, (ros::Time::now() - rrt_start_time).toSec());
+        }
+      }
+      sample_nums_ = idx;
+
+      publishTree(true);
+
+      if (goal_found)
+      {
+        final_path_use_time_ = (ros::Time::now() - rrt_start_time).toSec();
+        ROS_INFO_STREAM("[BRRT*]: first path length: " << solution_cost_time_pair_list_.front().first << ", use_time: " << first_path_use_time_);
+      }
+      else if (valid_tree_node_nums_ == max_tree_node_nums_)
+      {
+        ROS_ERROR_STREAM("[BRRT*]: NOT CONNECTED TO GOAL after " << max_tree_node_nums_ << " nodes added to rrt-trees");
+      }
+      else
+      {
+        ROS_ERROR_STREAM("[BRRT*]: NOT CONNECTED TO GOAL after " << (ros::Time::now() - rrt_start_time).toSec() << " seconds");
+      }
+      return goal_found;
+    }
+
+    /* RRTX-like reuse of the last tree for a new query: cut the edges that newly occupied voxels block and
+       drop the subtrees behind them, re-root at the new start, then let the cost changes cascade through
+       rewiring before the usual RRT* iterations continue */
+    bool reuseTree(const Eigen::Vector3d &s, const Eigen::Vector3d &g)
+    {
+      SCOPE_TRACE_ZONE("RRTStar::reuseTree");
+      if (valid_tree_node_nums_ < 2 || !kd_tree_) // needs at least the goal and the old root
+        return false;
+      final_path_.clear();
+      path_list_.clear();
+      solution_cost_time_pair_list_.clear();
+      segment_cache_.clear();
+      sample_nums_ = 0;
+      reuse_iterations_ = 0;
+      collision_check_nums_ = 0;
+
+      if (goal_node_->parent)
+        goal_node_->parent->children.remove(goal_node_);
+      goal_node_->parent = nullptr;
+      goal_node_->children.clear();
+
+      /* 1. cut blocked edges, an edge is at most search_radius_ long so the voxels blocking it are that
+            close to its child node */
+      vector<RRTNode3DPtr> candidates;
+      vector<Eigen::Vector3d> occupied;
+      if (map_ptr_->getOccupiedSince(map_stamp_, occupied) && (int)occupied.size() < valid_tree_node_nums_)
+      {
+        std::unordered_set<RRTNode3DPtr> visited;
+        double range = search_radius_ + map_ptr_->getResolution();
+        for (const auto &v : occupied)
+        {
+          struct kdres *nbr_set = kd_nearest_range3(kd_tree_.get(), v[0], v[1], v[2], range);
+          if (nbr_set == nullptr)
+            continue;
+          while (!kd_res_end(nbr_set))
+          {
+            RRTNode3DPtr node = (RRTNode3DPtr)kd_res_item_data(nbr_set);
+            if (visited.insert(node).second)
+              candidates.push_back(node);
+            kd_res_next(nbr_set);
+          }
+          kd_res_free(nbr_set);
+        }
+      }
+      else
+      {
+        candidates.assign(nodes_pool_.begin() + 1, nodes_pool_.begin() + valid_tree_node_nums_);
+      }
+      for (const auto &node : candidates)
+      {
+        if (node->parent && !isSegmentValid(node->parent->x, node->x))
+        {
+          node->parent->children.remove(node);
+          node->parent = nullptr;
+        }
+      }
+
+      /* 2. keep what is still connected to the old root, compact the pool and rebuild the kd index */
+      vector<RRTNode3DPtr> alive;
+      std::unordered_set<RRTNode3DPtr> alive_set;
+      std::queue<RRTNode3DPtr> Q;
+      Q.push(start_node_);
+      while (!Q.empty())
+      {
+        RRTNode3DPtr node = Q.front();
+        Q.pop();
+        alive.push_back(node);
+        alive_set.insert(node);
+        for (const auto &leafptr : node->children)
+          Q.push(leafptr);
+      }
+      vector<TreeNode *> pool;
+      pool.reserve(nodes_pool_.size());
+      pool.push_back(goal_node_);
+      pool.insert(pool.end(), alive.begin(), alive.end());
+      for (const auto &node : nodes_pool_)
+      {
+        if (node == goal_node_ || alive_set.count(node))
+          continue;
+        node->parent = nullptr;
+        node->children.clear();
+        pool.push_back(node);
+      }
+      nodes_pool_.swap(pool);
+      valid_tree_node_nums_ = 1 + alive.size();
+
+      kd_tree_.reset(kd_create(3));
+      for (const auto &node : alive)
+        kd_insert3(kd_tree_.get(), node->x[0], node->x[1], node->x[2], node);
+
+      /* 3. hang the new start onto the closest node it sees and reverse the edges up to the old root */
+      RRTNode3DPtr attach_node = nullptr;
+      double attach_dist = DBL_MAX;
+      struct kdres *nbr_set = kd_nearest_range3(kd_tree_.get(), s[0], s[1], s[2], search_radius_);
+      if (nbr_set == nullptr)
+        return false;
+      while (!kd_res_end(nbr_set))
+      {
+        RRTNode3DPtr node = (RRTNode3DPtr)kd_res_item_data(nbr_set);
+        double dist = calDist(node->x, s);
+        if (dist < attach_dist && isSegmentValid(node->x, s))
+        {
+          attach_dist = dist;
+          attach_node = node;
+        }
+        kd_res_next(nbr_set);
+      }
+      kd_res_free(nbr_set);
+      if (attach_node == nullptr)
+        return false;
+
+      RRTNode3DPtr new_root = nodes_pool_[valid_tree_node_nums_++];
+      new_root->x = s;
+      new_root->parent = nullptr;
+      new_root->children.clear();
+      new_root->cost_from_start = 0.0;
+      new_root->cost_from_parent = 0.0;
+      kd_insert3(kd_tree_.get(), s[0], s[1], s[2], new_root);
+      vector<RRTNode3DPtr> reversed_branch;
+      RRTNode3DPtr prev = new_root, curr = attach_node;
+      while (curr)
+      {
+        reversed_branch.push_back(curr);
+        RRTNode3DPtr next = curr->parent;
+        if (next)
+          next->children.remove(curr);
+        curr->parent = prev;
+        curr->cost_from_parent = calDist(prev->x, curr->x);
+        prev->children.push_back(curr);
+        prev = curr;
+        curr = next;
+      }
+      start_node_ = new_root;
+      changeNodeParent(attach_node, new_root, attach_dist); // refreshes all cost_from_start
+
+      /* 4. the goal may be reachable from the tree right away */
+      goal_node_->x = g;
+      goal_node_->cost_from_start = DBL_MAX;
+      nbr_set = kd_nearest_range3(kd_tree_.get(), g[0], g[1], g[2], search_radius_);
+      if (nbr_set != nullptr)
+      {
+        vector<std::pair<double, RRTNode3DPtr>> goal_parents;
+        while (!kd_res_end(nbr_set))
+        {
+          RRTNode3DPtr node = (RRTNode3DPtr)kd_res_item_data(nbr_set);
+          goal_parents.emplace_back(node->cost_from_start + calDist(node->x, g), node);
+          kd_res_next(nbr_set);
+        }
+        kd_res_free(nbr_set);
+        std::sort(goal_parents.begin(), goal_parents.end());
+        for (auto &cn : goal_parents)
+        {
+          if (!isSegmentValid(cn.second->x, g))
+            continue;
+          changeNodeParent(goal_node_, cn.second, calDist(cn.second->x, g));
+          first_path_use_time_ = (ros::Time::now() - plan_start_time_).toSec();
+          vector<Eigen::Vector3d> curr_best_path;
+          fillPath(goal_node_, curr_best_path);
+          path_list_.emplace_back(curr_best_path);
+          solution_cost_time_pair_list_.emplace_back(goal_node_->cost_from_start, first_path_use_time_);
+          break;
+        }
+      }
+
+      /* 5. rewiring cascade from the reversed branch, cheapest nodes first, the rest of the tree only
+            needs it where a rewired node now offers a shortcut. It may spread over the whole tree, so it
+            gets half of the search time or of max_iterations_, one iteration per pop, and the usual
+            iterations carry on the rewiring with the rest */
+      typedef std::pair<double, RRTNode3DPtr> CostNode;
+      std::priority_queue<CostNode, vector<CostNode>, std::greater<CostNode>> open;
+      for (const auto &node : reversed_branch)
+        open.emplace(node->cost_from_start, node);
+      double goal_cost = goal_node_->cost_from_start;
+      while (!open.empty() && withinBudget(2 * reuse_iterations_, search_time_ / 2))
+      {
+        RRTNode3DPtr node = open.top().second;
+        open.pop();
+        ++reuse_iterations_;
+        nbr_set = kd_nearest_range3(kd_tree_.get(), node->x[0], node->x[1], node->x[2], search_radius_);
+        if (nbr_set == nullptr)
+          continue;
+        while (!kd_res_end(nbr_set))
+        {
+          RRTNode3DPtr nbr = (RRTNode3DPtr)kd_res_item_data(nbr_set);
+          double dist = calDist(node->x, nbr->x);
+          if (node->cost_from_start + dist < nbr->cost_from_start - 1e-9 && isSegmentValid(node->x, nbr->x))
+          {
+            changeNodeParent(nbr, node, dist);
+            open.emplace(nbr->cost_from_start, nbr);
+          }
+          kd_res_next(nbr_set);
+        }
+        kd_res_free(nbr_set);
+      }
+
+      if (goal_node_->cost_from_start < goal_cost)
+      {
+        vector<Eigen::Vector3d> curr_best_path;
+        fillPath(goal_node_, curr_best_path);
+        path_list_.emplace_back(curr_best_path);
+        solution_cost_time_pair_list_.emplace_back(goal_node_->cost_from_start, (ros::Time::now() - plan_start_time_).toSec());
+      }
+      return true;
+    }
+
+    bool rrt_star(const Eigen::Vector3d &s, const Eigen::Vector3d &g)
+    {
+      SCOPE_TRACE_ZONE("RRT*");
+      ros::Time rrt_start_time = plan_start_time_;
+      bool goal_found = goal_node_->cost_from_start < DBL_MAX; // a reused tree may reach the goal already
+      kdtree *kd_tree = kd_tree_.get();
 
       /* main loop */
       int idx = 0;
-      for (idx = 0; (ros::Time::now() - rrt_start_time).toSec() < search_time_ && valid_tree_node_nums_ < max_tree_node_nums_; ++idx)
+      for (idx = 0; withinBudget(reuse_iterations_ + idx, search_time_) && valid_tree_node_nums_ < max_tree_node_nums_; ++idx)
       {
+        publishTree(false);
         /* biased random sampling */
         Eigen::Vector3d x_rand;
         //sampler_.samplingOnce(x_rand);
@@ -248,7 +823,7 @@ namespace path_plan
         kd_res_free(p_nearest);
 
         Eigen::Vector3d x_new = steer(nearest_node->x, x_rand, steer_length_);
-        if (!map_ptr_->isSegmentValid(nearest_node->x, x_new))
+        if (!isSegmentValid(nearest_node->x, x_new))
         {
           continue;
         }
@@ -272,6 +847,13 @@ namespace path_plan
         }
         kd_res_free(nbr_set); //reset kd tree range query
 
+        /* all neighbour edges share x_new, check them in one batch and keep the results for rewire */
+        vector<Eigen::Vector3d> neighbour_pts(neighbour_nodes.size());
+        for (size_t i = 0; i < neighbour_nodes.size(); ++i)
+          neighbour_pts[i] = neighbour_nodes[i]->x;
+        vector<bool> neighbour_valid;
+        areSegmentsValid(x_new, neighbour_pts, neighbour_valid);
+
         /* choose parent from kd tree range query result*/
         double dist2nearest = calDist(nearest_node->x, x_new);
         double min_dist_from_start(nearest_node->cost_from_start + dist2nearest);
@@ -287,9 +869,10 @@ namespace path_plan
         // !  4. [Optional] You can sort the potential parents first in increasing order by cost-from-start value;
         // !  5. [Optional] You can store the collison-checking results for later usage in the Rewire procedure.
         // ! Implement your own code inside the following loop
-        for (auto &curr_node : neighbour_nodes)
+        for (size_t i = 0; i < neighbour_nodes.size(); ++i)
         {
-          if (!map_ptr_->isSegmentValid(curr_node->x, x_new)) {
+          RRTNode3DPtr &curr_node = neighbour_nodes[i];
+          if (!neighbour_valid[i]) {
             continue;
           }
 
@@ -320,7 +903,7 @@ namespace path_plan
         double dist_to_goal = calDist(x_new, goal_node_->x);
         if (dist_to_goal <= search_radius_)
         {
-          bool is_connected2goal = map_ptr_->isSegmentValid(x_new, goal_node_->x);
+          bool is_connected2goal = isSegmentValid(x_new, goal_node_->x);
           // this test can be omitted if sample-rejction is applied
           bool is_better_path = goal_node_->cost_from_start > dist_to_goal + new_node->cost_from_start;
           if (is_connected2goal && is_better_path)
@@ -346,22 +929,24 @@ namespace path_plan
         // !  3. the variable [new_node] is the pointer of X_new;
         // !  4. [Optional] You can test whether the node is promising before checking edge collison.
         // ! Implement your own code between the dash lines [--------------] in the following loop
-        for (auto &curr_node : neighbour_nodes)
+        for (size_t i = 0; i < neighbour_nodes.size(); ++i)
         {
+          RRTNode3DPtr &curr_node = neighbour_nodes[i];
           double best_cost_before_rewire = goal_node_->cost_from_start;
           // ! -------------------------------------
-          if (!map_ptr_->isSegmentValid(curr_node->x, new_node->x)) {
+          if (!neighbour_valid[i]) {
             continue;
           }
 
           double new_to_curr = calDist(new_node->x,curr_node->x);
 
-          if (curr_node->cost_from_start < new_node->cost_from_start + new_to_curr) {
+          // a tie would let an ancestor at new_node's position become its child
+          if (curr_node->cost_from_start <= new_node->cost_from_start + new_to_curr) {
             continue;
           }
           changeNodeParent(curr_node, new_node, new_to_curr);
 
-          if (!map_ptr_->isSegmentValid(goal_node_->x, curr_node->x)) {
+          if (!isSegmentValid(goal_node_->x, curr_node->x)) {
             continue;
           }
 
@@ -387,21 +972,9 @@ namespace path_plan
         /* end of rewire */
       }
       /* end of sample once */
+      sample_nums_ = idx;
 
-      vector<Eigen::Vector3d> vertice;
-      vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> edges;
-      sampleWholeTree(start_node_, vertice, edges);
-      std::vector<visualization::BALL> balls;
-      balls.reserve(vertice.size());
-      visualization::BALL node_p;
-      node_p.radius = 0.06;
-      for (size_t i = 0; i < vertice.size(); ++i)
-      {
-        node_p.center = vertice[i];
-        balls.push_back(node_p);
-      }
-      vis_ptr_->visualize_balls(balls, "tree_vertice", visualization::Color::blue, 1.0);
-      vis_ptr_->visualize_pairline(edges, "tree_edges", visualization::Color::red, 0.04);
+      publishTree(true);
 
       if (goal_found)
       {
@@ -419,28 +992,6 @@ namespace path_plan
       }
       return goal_found;
     }
-
-    void sampleWholeTree(const RRTNode3DPtr &root, vector<Eigen::Vector3d> &vertice, vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> &edges)
-    {
-      if (root == nullptr)
-        return;
-
-      // whatever dfs or bfs
-      RRTNode3DPtr node = root;
-      std::queue<RRTNode3DPtr> Q;
-      Q.push(node);
-      while (!Q.empty())
-      {
-        node = Q.front();
-        Q.pop();
-        for (const auto &leafptr : node->children)
-        {
-          vertice.push_back(leafptr->x);
-          edges.emplace_back(std::make_pair(node->x, leafptr->x));
-          Q.push(leafptr);
-        }
-      }
-    }
   };
 
 } // namespace path_plan
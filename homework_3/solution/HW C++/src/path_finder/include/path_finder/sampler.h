@@ -38,6 +38,14 @@ public:
     origin_.setZero();
   };
 
+  // restart the random sequence, a fixed seed replays the same samples
+  void setSeed(uint64_t seed)
+  {
+    gen_.seed(seed);
+    uniform_rand_.reset();
+    normal_rand_.reset();
+  }
+
   void setSamplingRange(const Eigen::Vector3d origin, const Eigen::Vector3d range)
   {
     origin_ = origin;
@@ -0,0 +1,135 @@
+/*
+Copyright (C) 2022 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#ifndef TREE_PUBLISHER_H
+#define TREE_PUBLISHER_H
+
+#include "visualization/visualization.hpp"
+
+#include <ros/ros.h>
+#include <Eigen/Eigen>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace path_plan
+{
+  /* Publishes snapshots of a planner tree from its own thread. The planner only copies the node positions,
+     at most rate times per second and only while the tree topics have subscribers; building and sending
+     the markers happens here. The latest snapshot wins if the thread is still busy with the previous one. */
+  class TreePublisher
+  {
+  public:
+    TreePublisher(const ros::NodeHandle &nh, double rate)
+        : nh_(nh), vis_(nh_), period_(rate > 0.0 ? 1.0 / rate : 0.0), last_snapshot_time_(0.0),
+          subscribed_(true), has_snapshot_(false), stop_(false)
+    {
+      worker_ = std::thread(&TreePublisher::run, this);
+    }
+    ~TreePublisher()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      cv_.notify_one();
+      worker_.join();
+    }
+    TreePublisher(const TreePublisher &) = delete;
+    TreePublisher &operator=(const TreePublisher &) = delete;
+
+    // whether a snapshot taken now would be published, lets the planner skip collecting it
+    bool wantSnapshot(bool force) const
+    {
+      if (!subscribed_)
+        return false;
+      return force || (ros::Time::now() - last_snapshot_time_).toSec() >= period_;
+    }
+
+    void publish(vector<Eigen::Vector3d> &vertice, vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> &edges)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        vertice_.swap(vertice);
+        edges_.swap(edges);
+        has_snapshot_ = true;
+        last_snapshot_time_ = ros::Time::now();
+      }
+      cv_.notify_one();
+    }
+
+  private:
+    ros::NodeHandle nh_;
+    visualization::Visualization vis_; // only used by the worker thread
+    double period_;
+    ros::Time last_snapshot_time_;
+    std::atomic<bool> subscribed_;
+
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool has_snapshot_, stop_;
+    vector<Eigen::Vector3d> vertice_;
+    vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> edges_;
+
+    void run()
+    {
+      vector<Eigen::Vector3d> vertice;
+      vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> edges;
+      std::vector<visualization::BALL> balls;
+      while (true)
+      {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          // wake up now and then to notice subscribers that come and go between plans
+          cv_.wait_for(lock, std::chrono::seconds(1), [this]
+                       { return has_snapshot_ || stop_; });
+          if (stop_)
+            return;
+          if (!has_snapshot_)
+          {
+            lock.unlock();
+            subscribed_ = vis_.has_subscribers("tree_vertice") || vis_.has_subscribers("tree_edges");
+            continue;
+          }
+          vertice.swap(vertice_);
+          edges.swap(edges_);
+          has_snapshot_ = false;
+        }
+
+        balls.resize(vertice.size());
+        for (size_t i = 0; i < vertice.size(); ++i)
+        {
+          balls[i].center = vertice[i];
+          balls[i].radius = 0.06;
+        }
+        vis_.visualize_balls(balls, "tree_vertice", visualization::Color::blue, 1.0);
+        vis_.visualize_pairline(edges, "tree_edges", visualization::Color::red, 0.04);
+        subscribed_ = vis_.has_subscribers("tree_vertice") || vis_.has_subscribers("tree_edges");
+      }
+    }
+  };
+
+} // namespace path_plan
+
+#endif
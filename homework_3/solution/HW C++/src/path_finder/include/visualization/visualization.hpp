@@ -198,6 +198,14 @@ namespace visualization
     public:
         Visualization(ros::NodeHandle &nh) : nh_(nh) {}
 
+        // true until the topic is advertised, so the first visualize_ call on it goes through
+        template <class TOPIC>
+        bool has_subscribers(const TOPIC &topic) const
+        {
+            auto got = publisher_map_.find(topic);
+            return got == publisher_map_.end() || got->second.getNumSubscribers() > 0;
+        }
+
         template <class CENTER, class TOPIC>
         void visualize_a_ball(const CENTER &c,
                               const double &r,
@@ -0,0 +1,263 @@
+/*
+Copyright (C) 2022 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#include "occ_grid/occ_map.h"
+#include "path_finder/rrt_star.h"
+#include "path_finder/path_smoother.h"
+#include "path_finder/map_families.h"
+
+#include <ros/ros.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+// Headless planner benchmark: builds maps from the generators with fixed seeds, runs the planners
+// over a fixed set of start-goal queries per map, and dumps per-query statistics and the cost-time
+// convergence of every run to csv and json in output_dir.
+class PlannerBenchmark
+{
+private:
+    struct RunResult
+    {
+        std::string planner, map_type;
+        int map_seed, query_id;
+        Eigen::Vector3d start, goal;
+        bool success;
+        double plan_time;
+        int sample_nums, tree_node_nums;
+        size_t collision_check_nums, map_memory, tree_memory;
+        vector<std::pair<double, double>> solutions; // (cost, time)
+        double shortcut_cost, smooth_cost, smooth_time; // -1 without smoothing
+        size_t smooth_check_nums;
+    };
+
+    ros::NodeHandle nh_;
+    vector<std::string> map_types_, planners_;
+    int map_seed_, map_nums_, query_seed_, query_nums_;
+    bool chain_queries_, smooth_path_;
+    double min_query_dist_, map_resolution_;
+    std::string output_dir_;
+    vector<RunResult> results_;
+
+    static vector<std::string> split(const std::string &s)
+    {
+        vector<std::string> items;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                items.push_back(item);
+        return items;
+    }
+
+    void generateQueries(const env::OccMap::Ptr &map_ptr, int seed, vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> &queries)
+    {
+        std::mt19937_64 gen(seed);
+        std::uniform_real_distribution<double> uniform_rand(0.0, 1.0);
+        Eigen::Vector3d origin = map_ptr->getOrigin(), size = map_ptr->getMapSize();
+        auto sampleFree = [&](Eigen::Vector3d &p) {
+            for (int attempt = 0; attempt < 10000; ++attempt)
+            {
+                p = origin + Eigen::Vector3d(uniform_rand(gen), uniform_rand(gen), uniform_rand(gen)).cwiseProduct(size);
+                if (map_ptr->isStateValid(p))
+                    return true;
+            }
+            return false;
+        };
+
+        queries.clear();
+        for (int attempt = 0; attempt < 100 * query_nums_ && (int)queries.size() < query_nums_; ++attempt)
+        {
+            Eigen::Vector3d s, g;
+            // chained queries start where the last one ended, like goals clicked one after another
+            if (chain_queries_ && !queries.empty())
+                s = queries.back().second;
+            else if (!sampleFree(s))
+                break;
+            if (!sampleFree(g))
+                break;
+            if ((s - g).norm() >= min_query_dist_)
+                queries.emplace_back(s, g);
+        }
+    }
+
+    void runRRTStar(const std::shared_ptr<path_plan::RRTStar> &planner, const Eigen::Vector3d &s, const Eigen::Vector3d &g, RunResult &res)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        res.success = planner->plan(s, g);
+        res.plan_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        res.solutions = planner->getSolutions();
+        res.sample_nums = planner->getSampleNums();
+        res.collision_check_nums = planner->getCollisionCheckNums();
+        res.tree_node_nums = planner->getTreeNodeNums();
+        res.tree_memory = res.tree_node_nums * sizeof(TreeNode);
+    }
+
+    void runSmoother(const std::shared_ptr<path_plan::PathSmoother> &smoother, const vector<Eigen::Vector3d> &path, RunResult &res)
+    {
+        res.shortcut_cost = res.smooth_cost = res.smooth_time = -1.0;
+        res.smooth_check_nums = 0;
+        if (!smoother || !res.success)
+            return;
+        vector<Eigen::Vector3d> smoothed;
+        auto t0 = std::chrono::steady_clock::now();
+        smoother->process(path, smoothed);
+        res.smooth_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        res.shortcut_cost = path_plan::PathSmoother::pathLength(smoother->getShortcutPath());
+        res.smooth_cost = path_plan::PathSmoother::pathLength(smoothed);
+        res.smooth_check_nums = smoother->getCollisionCheckNums();
+    }
+
+    void writeResults()
+    {
+        mkdir(output_dir_.c_str(), 0755);
+
+        std::ofstream summary(output_dir_ + "/summary.csv");
+        summary << "planner,map_type,map_seed,query_id,success,first_cost,first_time,final_cost,plan_time,"
+                << "samples,samples_per_sec,collision_checks,collision_checks_per_sec,tree_nodes,tree_memory,map_memory,"
+                << "shortcut_cost,smooth_cost,smooth_time,smooth_checks\n";
+        std::ofstream curve(output_dir_ + "/convergence.csv");
+        curve << "planner,map_type,map_seed,query_id,time,cost\n";
+        std::ofstream json(output_dir_ + "/results.json");
+        json << "[\n";
+        for (size_t i = 0; i < results_.size(); ++i)
+        {
+            const RunResult &r = results_[i];
+            double first_cost = r.solutions.empty() ? -1.0 : r.solutions.front().first;
+            double first_time = r.solutions.empty() ? -1.0 : r.solutions.front().second;
+            double final_cost = r.solutions.empty() ? -1.0 : r.solutions.back().first;
+            summary << r.planner << "," << r.map_type << "," << r.map_seed << "," << r.query_id << "," << r.success << ","
+                    << first_cost << "," << first_time << "," << final_cost << "," << r.plan_time << ","
+                    << r.sample_nums << "," << r.sample_nums / r.plan_time << ","
+                    << r.collision_check_nums << "," << r.collision_check_nums / r.plan_time << ","
+                    << r.tree_node_nums << "," << r.tree_memory << "," << r.map_memory << ","
+                    << r.shortcut_cost << "," << r.smooth_cost << "," << r.smooth_time << "," << r.smooth_check_nums << "\n";
+            for (const auto &sln : r.solutions)
+                curve << r.planner << "," << r.map_type << "," << r.map_seed << "," << r.query_id << ","
+                      << sln.second << "," << sln.first << "\n";
+
+            json << "  {\"planner\": \"" << r.planner << "\", \"map_type\": \"" << r.map_type << "\", \"map_seed\": " << r.map_seed
+                 << ", \"query_id\": " << r.query_id
+                 << ", \"start\": [" << r.start(0) << ", " << r.start(1) << ", " << r.start(2) << "]"
+                 << ", \"goal\": [" << r.goal(0) << ", " << r.goal(1) << ", " << r.goal(2) << "]"
+                 << ", \"success\": " << (r.success ? "true" : "false") << ", \"plan_time\": " << r.plan_time
+                 << ", \"samples\": " << r.sample_nums << ", \"collision_checks\": " << r.collision_check_nums
+                 << ", \"tree_nodes\": " << r.tree_node_nums << ", \"tree_memory\": " << r.tree_memory
+                 << ", \"map_memory\": " << r.map_memory << ", \"shortcut_cost\": " << r.shortcut_cost
+                 << ", \"smooth_cost\": " << r.smooth_cost << ", \"smooth_time\": " << r.smooth_time
+                 << ", \"smooth_checks\": " << r.smooth_check_nums << ", \"solutions\": [";
+            for (size_t k = 0; k < r.solutions.size(); ++k)
+                json << (k ? ", " : "") << "[" << r.solutions[k].second << ", " << r.solutions[k].first << "]";
+            json << "]}" << (i + 1 < results_.size() ? "," : "") << "\n";
+        }
+        json << "]\n";
+        ROS_INFO_STREAM("[benchmark] " << results_.size() << " runs written to " << output_dir_);
+    }
+
+public:
+    PlannerBenchmark(const ros::NodeHandle &nh) : nh_(nh)
+    {
+        std::string map_types, planners;
+        nh_.param("benchmark/map_types", map_types, std::string("forest,perlin3d,random,maze2d,maze3d"));
+        nh_.param("benchmark/planners", planners, std::string("rrt_star"));
+        nh_.param("benchmark/map_seed", map_seed_, 1);
+        nh_.param("benchmark/map_nums", map_nums_, 3);
+        nh_.param("benchmark/query_seed", query_seed_, 1);
+        nh_.param("benchmark/query_nums", query_nums_, 10);
+        nh_.param("benchmark/min_query_dist", min_query_dist_, 10.0);
+        nh_.param("benchmark/chain_queries", chain_queries_, false);
+        nh_.param("benchmark/smooth_path", smooth_path_, false);
+        nh_.param("benchmark/map_resolution", map_resolution_, 0.1);
+        nh_.param("benchmark/output_dir", output_dir_, std::string("/tmp/planner_benchmark"));
+        map_types_ = split(map_types);
+        planners_ = split(planners);
+    }
+    ~PlannerBenchmark(){};
+
+    void run()
+    {
+        results_.clear();
+        for (const auto &map_type : map_types_)
+        {
+            for (int m = 0; m < map_nums_; ++m)
+            {
+                int map_seed = map_seed_ + m;
+                env::OccMap::Ptr env_ptr = std::make_shared<env::OccMap>();
+                env_ptr->init(nh_);
+                pcl::PointCloud<pcl::PointXYZ> cloud;
+                if (!path_plan::generateMapFamily(nh_, map_type, map_seed, env_ptr->getMapSize(), map_resolution_, cloud))
+                    break;
+                env_ptr->setGlobalMap(cloud);
+
+                vector<std::pair<Eigen::Vector3d, Eigen::Vector3d>> queries;
+                generateQueries(env_ptr, query_seed_ + m, queries);
+                ROS_INFO_STREAM("[benchmark] map " << map_type << " seed " << map_seed << ": " << cloud.points.size()
+                                                   << " points, " << queries.size() << " queries");
+
+                std::shared_ptr<path_plan::PathSmoother> smoother_ptr;
+                if (smooth_path_)
+                    smoother_ptr = std::make_shared<path_plan::PathSmoother>(nh_, env_ptr);
+
+                for (const auto &planner : planners_)
+                {
+                    std::shared_ptr<path_plan::RRTStar> rrt_star_ptr;
+                    if (planner == "rrt_star" || planner == "brrt_star" || planner == "rrt_star_reuse")
+                    {
+                        rrt_star_ptr = std::make_shared<path_plan::RRTStar>(nh_, env_ptr);
+                        rrt_star_ptr->setBidirectional(planner == "brrt_star");
+                        rrt_star_ptr->setReuseTree(planner == "rrt_star_reuse");
+                    }
+                    else
+                    {
+                        ROS_ERROR_STREAM("[benchmark] unknown planner: " << planner);
+                        continue;
+                    }
+                    for (size_t q = 0; q < queries.size(); ++q)
+                    {
+                        RunResult res;
+                        res.planner = planner;
+                        res.map_type = map_type;
+                        res.map_seed = map_seed;
+                        res.query_id = q;
+                        res.start = queries[q].first;
+                        res.goal = queries[q].second;
+                        res.map_memory = env_ptr->getMemoryUsage();
+                        runRRTStar(rrt_star_ptr, res.start, res.goal, res);
+                        runSmoother(smoother_ptr, rrt_star_ptr->getPath(), res);
+                        results_.push_back(res);
+                    }
+                }
+            }
+        }
+        writeResults();
+    }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "planner_benchmark_node");
+    ros::NodeHandle nh("~");
+
+    PlannerBenchmark benchmark(nh);
+    benchmark.run();
+    return 0;
+}
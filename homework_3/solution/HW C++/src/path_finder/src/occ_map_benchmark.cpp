@@ -0,0 +1,281 @@
+/*
+Copyright (C) 2022 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#include "occ_grid/occ_map.h"
+#include "occ_grid/raycast.h"
+#include "path_finder/map_families.h"
+
+#include <ros/ros.h>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+
+// Occupancy storage benchmark: fills an OccMap per storage_type and pyramid_levels combination with the
+// same generated map and reports its memory and the isStateValid / isSegmentValid throughput on a fixed
+// set of random queries. The std::vector<bool> grid with the RayCaster walk that OccMap used before is
+// measured alongside as the baseline, the states have to agree with it exactly.
+class OccMapBenchmark
+{
+private:
+    // the former OccMap occupancy, kept here as the reference
+    class VectorBoolGrid
+    {
+    public:
+        void init(const Eigen::Vector3d &origin, const Eigen::Vector3d &map_size, double resolution)
+        {
+            origin_ = origin;
+            resolution_ = resolution;
+            resolution_inv_ = 1.0 / resolution;
+            for (int i = 0; i < 3; ++i)
+                grid_size_(i) = ceil(map_size(i) * resolution_inv_);
+            grid_size_y_multiply_z_ = grid_size_(1) * grid_size_(2);
+            occupancy_buffer_.assign(grid_size_(0) * grid_size_y_multiply_z_, false);
+            // x-y and z-low boundary, stepped as OccMap steps it
+            Eigen::Vector3d max_range = origin + map_size, half = Eigen::Vector3d::Constant(resolution / 2);
+            for (double cx = origin(0) + half(0); cx <= max_range(0) - half(0); cx += resolution)
+                for (double cz = origin(2) + half(2); cz <= max_range(2) - half(2); cz += resolution)
+                {
+                    setOccupancy(Eigen::Vector3d(cx, origin(1) + half(1), cz));
+                    setOccupancy(Eigen::Vector3d(cx, max_range(1) - half(1), cz));
+                }
+            for (double cy = origin(1) + half(1); cy <= max_range(1) - half(1); cy += resolution)
+                for (double cz = origin(2) + half(2); cz <= max_range(2) - half(2); cz += resolution)
+                {
+                    setOccupancy(Eigen::Vector3d(origin(0) + half(0), cy, cz));
+                    setOccupancy(Eigen::Vector3d(max_range(0) - half(0), cy, cz));
+                }
+            for (double cx = origin(0) + half(0); cx <= max_range(0) - half(0); cx += resolution)
+                for (double cy = origin(1) + half(1); cy <= max_range(1) - half(1); cy += resolution)
+                    setOccupancy(Eigen::Vector3d(cx, cy, origin(2) + half(2)));
+        }
+        void setOccupancy(const Eigen::Vector3d &pos)
+        {
+            Eigen::Vector3i idx = posToIndex(pos);
+            if (isInMap(idx))
+                occupancy_buffer_[idxToAddress(idx)] = true;
+        }
+        bool isStateValid(const Eigen::Vector3d &pos) const
+        {
+            Eigen::Vector3i idx = posToIndex(pos);
+            if (!isInMap(idx))
+                return false;
+            return (occupancy_buffer_[idxToAddress(idx)] == false);
+        }
+        bool isSegmentValid(const Eigen::Vector3d &p0, const Eigen::Vector3d &p1) const
+        {
+            RayCaster raycaster;
+            bool need_ray = raycaster.setInput(p0 / resolution_, p1 / resolution_);
+            if (!need_ray)
+                return true;
+            Eigen::Vector3d half = Eigen::Vector3d(0.5, 0.5, 0.5);
+            Eigen::Vector3d ray_pt;
+            if (!raycaster.step(ray_pt))
+                return true;
+            while (raycaster.step(ray_pt))
+            {
+                if (!isStateValid((ray_pt + half) * resolution_))
+                    return false;
+            }
+            return true;
+        }
+        size_t memoryUsage() const { return (occupancy_buffer_.size() + 7) / 8; }
+
+    private:
+        Eigen::Vector3d origin_;
+        double resolution_, resolution_inv_;
+        Eigen::Vector3i grid_size_;
+        int grid_size_y_multiply_z_;
+        std::vector<bool> occupancy_buffer_;
+
+        Eigen::Vector3i posToIndex(const Eigen::Vector3d &pos) const
+        {
+            return ((pos - origin_) * resolution_inv_).array().floor().cast<int>();
+        }
+        bool isInMap(const Eigen::Vector3i &id) const
+        {
+            return (id.array() >= 0).all() && (id.array() < grid_size_.array()).all();
+        }
+        int idxToAddress(const Eigen::Vector3i &id) const
+        {
+            return id(0) * grid_size_y_multiply_z_ + id(1) * grid_size_(2) + id(2);
+        }
+    };
+
+    struct Queries
+    {
+        vector<Eigen::Vector3d> states, seg_starts, seg_ends;
+    };
+
+    ros::NodeHandle nh_;
+    vector<std::string> map_types_, storage_types_;
+    vector<int> pyramid_levels_;
+    int map_seed_, query_nums_, state_repeats_;
+    double map_resolution_, max_segment_length_;
+
+    static vector<std::string> split(const std::string &s)
+    {
+        vector<std::string> items;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                items.push_back(item);
+        return items;
+    }
+
+    // segments run between free states, as the planners query them, the old walk skipped both end voxels
+    void generateQueries(const Eigen::Vector3d &origin, const Eigen::Vector3d &size, const VectorBoolGrid &baseline,
+                         Queries &q) const
+    {
+        std::mt19937_64 gen(map_seed_);
+        std::uniform_real_distribution<double> uniform_rand(0.0, 1.0);
+        auto samplePoint = [&]() {
+            return Eigen::Vector3d(origin + Eigen::Vector3d(uniform_rand(gen), uniform_rand(gen), uniform_rand(gen)).cwiseProduct(size));
+        };
+        q.states.resize(query_nums_);
+        q.seg_starts.resize(query_nums_);
+        q.seg_ends.resize(query_nums_);
+        for (int i = 0; i < query_nums_; ++i)
+        {
+            q.states[i] = samplePoint();
+            do
+            {
+                q.seg_starts[i] = samplePoint();
+                Eigen::Vector3d dir(uniform_rand(gen) - 0.5, uniform_rand(gen) - 0.5, uniform_rand(gen) - 0.5);
+                q.seg_ends[i] = q.seg_starts[i] + dir.normalized() * max_segment_length_ * uniform_rand(gen);
+                q.seg_ends[i] = q.seg_ends[i].cwiseMax(origin).cwiseMin(origin + size - Eigen::Vector3d::Constant(1e-6));
+            } while (!baseline.isStateValid(q.seg_starts[i]) || !baseline.isStateValid(q.seg_ends[i]));
+        }
+    }
+
+    // queries per second of isStateValid over all states state_repeats_ times, and of isSegmentValid
+    template <class Map>
+    void measure(const Map &map, const Queries &q, vector<bool> &states, vector<bool> &segments, double &state_rate,
+                 double &segment_rate) const
+    {
+        states.assign(q.states.size(), false);
+        segments.assign(q.seg_starts.size(), false);
+        // the volatile store keeps the inlined queries of the timed loop from being folded together
+        volatile bool sink;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < state_repeats_; ++r)
+            for (size_t i = 0; i < q.states.size(); ++i)
+                sink = map.isStateValid(q.states[i]);
+        auto t1 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < q.seg_starts.size(); ++i)
+            segments[i] = map.isSegmentValid(q.seg_starts[i], q.seg_ends[i]);
+        auto t2 = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < q.states.size(); ++i)
+            states[i] = map.isStateValid(q.states[i]);
+        state_rate = state_repeats_ * q.states.size() / std::chrono::duration<double>(t1 - t0).count();
+        segment_rate = q.seg_starts.size() / std::chrono::duration<double>(t2 - t1).count();
+        (void)sink;
+    }
+
+    static std::string row(const std::string &layout, const std::string &levels, size_t memory, double state_rate,
+                           double segment_rate, int state_diffs, int segment_diffs)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "%-13s %6s %11.1f KB %9.1f Mq/s %9.2f Mq/s %10d %10d", layout.c_str(), levels.c_str(),
+                 memory / 1024.0, state_rate * 1e-6, segment_rate * 1e-6, state_diffs, segment_diffs);
+        return line;
+    }
+
+    static int countDiffs(const vector<bool> &a, const vector<bool> &b)
+    {
+        int diffs = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+            diffs += a[i] != b[i];
+        return diffs;
+    }
+
+public:
+    OccMapBenchmark(const ros::NodeHandle &nh) : nh_(nh)
+    {
+        std::string map_types, storage_types, pyramid_levels;
+        nh_.param("benchmark/map_types", map_types, std::string("forest,perlin3d"));
+        nh_.param("benchmark/storage_types", storage_types, std::string("dense,block_sparse"));
+        nh_.param("benchmark/pyramid_levels", pyramid_levels, std::string("0,2"));
+        nh_.param("benchmark/map_seed", map_seed_, 1);
+        nh_.param("benchmark/query_nums", query_nums_, 200000);
+        nh_.param("benchmark/state_repeats", state_repeats_, 10);
+        nh_.param("benchmark/map_resolution", map_resolution_, 0.1);
+        nh_.param("benchmark/max_segment_length", max_segment_length_, 5.0);
+        map_types_ = split(map_types);
+        storage_types_ = split(storage_types);
+        for (const auto &level : split(pyramid_levels))
+            pyramid_levels_.push_back(std::stoi(level));
+    }
+    ~OccMapBenchmark(){};
+
+    void run()
+    {
+        for (const auto &map_type : map_types_)
+        {
+            // the map geometry comes from the occ_map/ params, the layout params are overwritten per run
+            env::OccMap::Ptr env_ptr = std::make_shared<env::OccMap>();
+            env_ptr->init(nh_);
+            Eigen::Vector3d origin = env_ptr->getOrigin(), size = env_ptr->getMapSize();
+            pcl::PointCloud<pcl::PointXYZ> cloud;
+            if (!path_plan::generateMapFamily(nh_, map_type, map_seed_, size, map_resolution_, cloud))
+                continue;
+            VectorBoolGrid baseline;
+            baseline.init(origin, size, env_ptr->getResolution());
+            for (const auto &pt : cloud.points)
+                baseline.setOccupancy(Eigen::Vector3d(pt.x, pt.y, pt.z));
+            Queries q;
+            generateQueries(origin, size, baseline, q);
+            vector<bool> base_states, base_segments, states, segments;
+            double state_rate, segment_rate;
+            measure(baseline, q, base_states, base_segments, state_rate, segment_rate);
+
+            ROS_INFO_STREAM("[occ_map_benchmark] map " << map_type << ", " << cloud.points.size() << " points, "
+                                                       << query_nums_ << " queries");
+            ROS_INFO_STREAM("layout        levels      memory           state         segment  state diff  seg diff");
+            ROS_INFO_STREAM(row("vector<bool>", "-", baseline.memoryUsage(), state_rate, segment_rate, 0, 0));
+            for (const auto &storage_type : storage_types_)
+            {
+                for (int levels : pyramid_levels_)
+                {
+                    nh_.setParam("occ_map/storage_type", storage_type);
+                    nh_.setParam("occ_map/pyramid_levels", levels);
+                    env_ptr = std::make_shared<env::OccMap>();
+                    env_ptr->init(nh_);
+                    env_ptr->setGlobalMap(cloud);
+                    measure(*env_ptr, q, states, segments, state_rate, segment_rate);
+                    // segments may differ where the traversals disagree on grazed voxel corners
+                    ROS_INFO_STREAM(row(storage_type, std::to_string(levels), env_ptr->getMemoryUsage(), state_rate, segment_rate,
+                                        countDiffs(states, base_states), countDiffs(segments, base_segments)));
+                }
+            }
+        }
+    }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "occ_map_benchmark_node");
+    ros::NodeHandle nh("~");
+
+    OccMapBenchmark benchmark(nh);
+    benchmark.run();
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+Copyright (C) 2022 Hongkai Ye (kyle_yeh@163.com)
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+#include "occ_grid/occ_map.h"
+#include "path_finder/rrt_star.h"
+#include "path_finder/map_families.h"
+#include "map_generator/depth_sensor.h"
+
+#include <ros/ros.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+// Offline load test of local mapping and replanning: a simulated depth sensor flies a circle through a
+// generated map, a producer thread renders its scans into a short queue, and the main thread fuses them
+// into a local sensing OccMap and replans every replan_every scans. Scans are stamped at sensor/rate
+// along the trajectory; with realtime they are also released at that rate, otherwise as fast as they
+// render. Per scan timings go to output_dir/sensor_load.csv.
+class SensorLoadTest
+{
+private:
+    struct Scan
+    {
+        int id;
+        double stamp, render_time;
+        Eigen::Vector3d pos;
+        vector<Eigen::Vector3d> points;
+        std::chrono::steady_clock::time_point ready;
+    };
+    struct ScanRecord
+    {
+        int id;
+        double stamp, render_time, queue_time, fuse_time, replan_time; // replan_time -1 without replan
+        size_t point_nums;
+        bool replan_success;
+    };
+
+    ros::NodeHandle nh_;
+    std::string map_type_, output_dir_;
+    int map_seed_, scan_nums_, queue_size_, replan_every_;
+    double map_resolution_, rate_, radius_, height_, speed_, replan_horizon_;
+    bool realtime_;
+    Eigen::Vector3d world_size_;
+    map_gen::DepthSensor sensor_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Scan> queue_;
+    vector<ScanRecord> records_;
+
+    void pose(double stamp, Eigen::Vector3d &pos, Eigen::Matrix3d &rot) const
+    {
+        double angle = speed_ * stamp / radius_;
+        pos = Eigen::Vector3d(radius_ * cos(angle), radius_ * sin(angle), height_);
+        rot = Eigen::AngleAxisd(angle + M_PI / 2, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+    }
+
+    void produce()
+    {
+        auto t_start = std::chrono::steady_clock::now();
+        for (int k = 0; k < scan_nums_; ++k)
+        {
+            Scan scan;
+            scan.id = k;
+            scan.stamp = k / rate_;
+            if (realtime_)
+                std::this_thread::sleep_until(t_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(scan.stamp)));
+            Eigen::Matrix3d rot;
+            pose(scan.stamp, scan.pos, rot);
+            auto t0 = std::chrono::steady_clock::now();
+            sensor_.scan(scan.pos, rot, scan.points);
+            scan.ready = std::chrono::steady_clock::now();
+            scan.render_time = std::chrono::duration<double>(scan.ready - t0).count();
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]
+                     { return (int)queue_.size() < queue_size_; });
+            queue_.push_back(std::move(scan));
+            cv_.notify_all();
+        }
+    }
+
+    static double percentile(vector<double> v, double p)
+    {
+        if (v.empty())
+            return -1.0;
+        size_t k = std::min(v.size() - 1, size_t(p * v.size()));
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    }
+
+    void report(double wall_time)
+    {
+        vector<double> render, fuse, replan;
+        size_t point_nums = 0;
+        for (const auto &r : records_)
+        {
+            render.push_back(r.render_time);
+            fuse.push_back(r.fuse_time);
+            if (r.replan_time >= 0.0)
+                replan.push_back(r.replan_time);
+            point_nums += r.point_nums;
+        }
+        ROS_INFO_STREAM("[sensor_load_test] " << records_.size() << " scans of " << sensor_.getRayNum() << " rays in " << wall_time
+                                              << " s: " << records_.size() / wall_time << " scans/s, " << point_nums / wall_time << " points/s");
+        ROS_INFO_STREAM("[sensor_load_test] render p50 " << percentile(render, 0.5) << " p99 " << percentile(render, 0.99)
+                                                         << " s, fuse p50 " << percentile(fuse, 0.5) << " p99 " << percentile(fuse, 0.99)
+                                                         << " s, replan p50 " << percentile(replan, 0.5) << " p99 " << percentile(replan, 0.99) << " s");
+
+        mkdir(output_dir_.c_str(), 0755);
+        std::ofstream csv(output_dir_ + "/sensor_load.csv");
+        csv << "scan_id,stamp,points,render_time,queue_time,fuse_time,replan_time,replan_success\n";
+        for (const auto &r : records_)
+            csv << r.id << "," << r.stamp << "," << r.point_nums << "," << r.render_time << "," << r.queue_time << ","
+                << r.fuse_time << "," << r.replan_time << "," << r.replan_success << "\n";
+    }
+
+public:
+    SensorLoadTest(const ros::NodeHandle &nh) : nh_(nh)
+    {
+        nh_.param("load_test/map_type", map_type_, std::string("forest"));
+        nh_.param("load_test/map_seed", map_seed_, 1);
+        nh_.param("load_test/map_resolution", map_resolution_, 0.1);
+        nh_.param("load_test/world_size_x", world_size_(0), 50.0);
+        nh_.param("load_test/world_size_y", world_size_(1), 50.0);
+        nh_.param("load_test/world_size_z", world_size_(2), 8.0);
+        nh_.param("load_test/scan_nums", scan_nums_, 1000);
+        nh_.param("load_test/queue_size", queue_size_, 4);
+        nh_.param("load_test/realtime", realtime_, false);
+        nh_.param("load_test/radius", radius_, 10.0);
+        nh_.param("load_test/height", height_, 1.5);
+        nh_.param("load_test/speed", speed_, 2.0);
+        nh_.param("load_test/replan_every", replan_every_, 10);
+        nh_.param("load_test/replan_horizon", replan_horizon_, 3.0);
+        nh_.param("load_test/output_dir", output_dir_, std::string("/tmp/sensor_load_test"));
+
+        map_gen::DepthSensorParams param;
+        nh_.param("sensor/rate", rate_, 100.0);
+        nh_.param("sensor/model", param.model, std::string("camera"));
+        nh_.param("sensor/width", param.width, 160);
+        nh_.param("sensor/height", param.height, 120);
+        nh_.param("sensor/h_fov", param.h_fov, 87.0);
+        nh_.param("sensor/v_fov", param.v_fov, 58.0);
+        nh_.param("sensor/max_range", param.max_range, 5.0);
+        nh_.param("sensor/emit_misses", param.emit_misses, true);
+        sensor_.setParams(param);
+        queue_size_ = std::max(queue_size_, 1);
+        if (rate_ <= 0.0)
+            rate_ = 100.0;
+    }
+    ~SensorLoadTest(){};
+
+    void run()
+    {
+        pcl::PointCloud<pcl::PointXYZ> cloud;
+        if (!path_plan::generateMapFamily(nh_, map_type_, map_seed_, world_size_, map_resolution_, cloud))
+            return;
+        sensor_.setWorld(cloud, map_resolution_);
+        ROS_INFO_STREAM("[sensor_load_test] map " << map_type_ << " seed " << map_seed_ << ": " << cloud.points.size() << " points");
+
+        env::OccMap::Ptr env_ptr = std::make_shared<env::OccMap>();
+        env_ptr->init(nh_);
+        std::shared_ptr<path_plan::RRTStar> rrt_star_ptr;
+        if (replan_every_ > 0)
+            rrt_star_ptr = std::make_shared<path_plan::RRTStar>(nh_, env_ptr);
+
+        records_.clear();
+        auto t_start = std::chrono::steady_clock::now();
+        std::thread producer(&SensorLoadTest::produce, this);
+        for (int k = 0; k < scan_nums_; ++k)
+        {
+            Scan scan;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]
+                         { return !queue_.empty(); });
+                scan = std::move(queue_.front());
+                queue_.pop_front();
+                cv_.notify_all();
+            }
+            ScanRecord rec;
+            rec.id = scan.id;
+            rec.stamp = scan.stamp;
+            rec.render_time = scan.render_time;
+            rec.point_nums = scan.points.size();
+            auto t0 = std::chrono::steady_clock::now();
+            rec.queue_time = std::chrono::duration<double>(t0 - scan.ready).count();
+            env_ptr->updateLocalMap(scan.pos, scan.points);
+            auto t1 = std::chrono::steady_clock::now();
+            rec.fuse_time = std::chrono::duration<double>(t1 - t0).count();
+            rec.replan_time = -1.0;
+            rec.replan_success = false;
+            if (rrt_star_ptr && scan.id % replan_every_ == 0)
+            {
+                Eigen::Vector3d goal;
+                Eigen::Matrix3d rot;
+                pose(scan.stamp + replan_horizon_, goal, rot);
+                rec.replan_success = rrt_star_ptr->plan(scan.pos, goal);
+                rec.replan_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+            }
+            records_.push_back(rec);
+        }
+        producer.join();
+        report(std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count());
+    }
+};
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "sensor_load_test_node");
+    ros::NodeHandle nh("~");
+
+    SensorLoadTest load_test(nh);
+    load_test.run();
+    return 0;
+}
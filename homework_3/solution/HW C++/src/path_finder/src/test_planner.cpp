@@ -21,7 +21,9 @@ OF SUCH DAMAGE.
 #include "self_msgs_and_srvs/GlbObsRcv.h"
 #include "occ_grid/occ_map.h"
 #include "path_finder/rrt_star.h"
+#include "path_finder/path_smoother.h"
 #include "visualization/visualization.hpp"
+#include "scope_trace/scope_trace.hpp"
 
 #include <ros/ros.h>
 #include <geometry_msgs/PoseStamped.h>
@@ -37,6 +39,7 @@ private:
     env::OccMap::Ptr env_ptr_;
     std::shared_ptr<visualization::Visualization> vis_ptr_;
     shared_ptr<path_plan::RRTStar> rrt_star_ptr_;
+    shared_ptr<path_plan::PathSmoother> path_smoother_ptr_;
 
     Eigen::Vector3d start_, goal_;
 
@@ -50,6 +53,7 @@ public:
 
         rrt_star_ptr_.reset(new path_plan::RRTStar(nh_, env_ptr_));
         rrt_star_ptr_->setVisualizer(vis_ptr_);
+        path_smoother_ptr_.reset(new path_plan::PathSmoother(nh_, env_ptr_));
 
         goal_sub_ = nh_.subscribe("/goal", 1, &TesterPathFinder::goalCallback, this);
         execution_timer_ = nh_.createTimer(ros::Duration(1), &TesterPathFinder::executionCallback, this);
@@ -61,6 +65,7 @@ public:
 
     void goalCallback(const geometry_msgs::PoseStamped::ConstPtr &goal_msg)
     {
+        SCOPE_TRACE_ZONE("goalCallback");
         goal_[0] = goal_msg->pose.position.x;
         goal_[1] = goal_msg->pose.position.y;
         goal_[2] = goal_msg->pose.position.z;
@@ -68,6 +73,8 @@ public:
         vis_ptr_->visualize_a_ball(start_, 0.3, "start", visualization::Color::pink);
         vis_ptr_->visualize_a_ball(goal_, 0.3, "goal", visualization::Color::steelblue);
 
+        // the spinner may run map updates on another thread meanwhile, hold them off until the path is smoothed
+        std::lock_guard<std::mutex> map_lock(env_ptr_->getUpdateMutex());
         bool rrt_star_res = rrt_star_ptr_->plan(start_, goal_);
         if (rrt_star_res)
         {
@@ -78,6 +85,13 @@ public:
             vis_ptr_->visualize_pointcloud(final_path, "rrt_star_final_wpts");
             vector<std::pair<double, double>> slns = rrt_star_ptr_->getSolutions();
             ROS_INFO_STREAM("[RRT*] final path len: " << slns.back().first);
+
+            vector<Eigen::Vector3d> smoothed_path;
+            path_smoother_ptr_->process(final_path, smoothed_path);
+            vis_ptr_->visualize_path(path_smoother_ptr_->getShortcutPath(), "shortcut_path");
+            vis_ptr_->visualize_path(smoothed_path, "smoothed_path");
+            ROS_INFO_STREAM("[PathSmoother] shortcut path len: " << path_plan::PathSmoother::pathLength(path_smoother_ptr_->getShortcutPath())
+                                                                 << ", smoothed path len: " << path_plan::PathSmoother::pathLength(smoothed_path));
             start_ = goal_;
         }
     }
@@ -103,10 +117,18 @@ int main(int argc, char **argv)
     ros::init(argc, argv, "test_path_finder_node");
     ros::NodeHandle nh("~");
 
+    bool trace_enable;
+    std::string trace_output;
+    nh.param("trace/enable", trace_enable, false);
+    nh.param("trace/output", trace_output, std::string("/tmp/test_path_finder_trace.json"));
+    scope_trace::setEnabled(trace_enable);
+
     TesterPathFinder tester(nh);
 
     ros::AsyncSpinner spinner(0);
     spinner.start();
     ros::waitForShutdown();
+    if (trace_enable && scope_trace::dump(trace_output))
+        ROS_INFO("[test_path_finder] trace written to %s", trace_output.c_str());
     return 0;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define _STATE_H_
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
 #include <ros/ros.h>
 #include <ros/console.h>
 #include <Eigen/Eigen>
@@ -10,17 +12,20 @@
 struct TrajectoryState;
 typedef TrajectoryState* TrajectoryStatePtr;
 
+// A trajectory piece p(t) = coeff.row(0) t^3 + coeff.row(1) t^2 + coeff.row(2) t + coeff.row(3), 0 <= t <= duration.
+// Constant acceleration primitives leave the cubic row zero, the OBVP trajectories use all of them; samples
+// are only evaluated when they are needed, at whatever resolution the consumer asks for
 struct TrajectoryState
 {
-    std::vector<Eigen::Vector3d> Position;
-    std::vector<Eigen::Vector3d> Velocity;
+    Eigen::Matrix<double, 4, 3> coeff;
+    double duration;
     double Trajctory_Cost ;
     bool collision_check ;           //False -> no collision, True -> collision
     bool optimal_flag;               //False -> not optimal in TraLibrary, True -> not optimal in TraLibrary, 
 
-    TrajectoryState(std::vector<Eigen::Vector3d> _Position, std::vector<Eigen::Vector3d> _Velocity,double _Trajctory_Cost){
-        Position        = _Position;
-        Velocity        = _Velocity;
+    TrajectoryState(const Eigen::Matrix<double, 4, 3> & _coeff, double _duration, double _Trajctory_Cost){
+        coeff           = _coeff;
+        duration        = _duration;
         Trajctory_Cost  = _Trajctory_Cost;
         collision_check = false;
         optimal_flag    = false;
@@ -28,6 +33,33 @@ struct TrajectoryState
     TrajectoryState(){};
     ~TrajectoryState(){};
 
+    // constant acceleration from a start state
+    void setPrimitive(const Eigen::Vector3d & start_position, const Eigen::Vector3d & start_velocity, const Eigen::Vector3d & input, double _duration){
+        coeff.row(0).setZero();
+        coeff.row(1) = 0.5 * input.transpose();
+        coeff.row(2) = start_velocity.transpose();
+        coeff.row(3) = start_position.transpose();
+        duration     = _duration;
+    }
+
+    Eigen::Vector3d getPosition(double t) const {
+        return (((coeff.row(0) * t + coeff.row(1)) * t + coeff.row(2)) * t + coeff.row(3)).transpose();
+    }
+    Eigen::Vector3d getVelocity(double t) const {
+        return ((3 * coeff.row(0) * t + 2 * coeff.row(1)) * t + coeff.row(2)).transpose();
+    }
+    // bound on the speed over the whole piece
+    double getMaxSpeed() const {
+        return 3 * coeff.row(0).norm() * duration * duration + 2 * coeff.row(1).norm() * duration + coeff.row(2).norm();
+    }
+    // positions from 0 to duration, evenly spaced at most max_dt apart
+    void samplePosition(double max_dt, std::vector<Eigen::Vector3d> & samples) const {
+        int sample_num = std::max(1, (int)ceil(duration / max_dt));
+        samples.resize(sample_num + 1);
+        for(int i = 0; i <= sample_num; i++)
+            samples[i] = getPosition(duration * i / sample_num);
+    }
+
     void setCollisionfree(){
         collision_check = true;
     }
@@ -36,4 +68,4 @@ struct TrajectoryState
     }
 };
 
-#endif
\ No newline at end of file
+#endif
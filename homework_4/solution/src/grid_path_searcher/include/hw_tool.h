@@ -25,6 +25,8 @@ class Homeworktool
 
 		Eigen::Vector3d gridIndex2coord(const Eigen::Vector3i & index);
 		Eigen::Vector3i coord2gridIndex(const Eigen::Vector3d & pt);
+		// indices outside the map are clamped to the border like coord2gridIndex does
+		bool isOccupiedIndex(int idx_x, int idx_y, int idx_z) const;
 
 	public:
 		Homeworktool(){};
@@ -33,9 +35,17 @@ class Homeworktool
 		void initGridMap(double _resolution, Eigen::Vector3d global_xyz_l, Eigen::Vector3d global_xyz_u, int max_x_id, int max_y_id, int max_z_id);
 		void setObs(const double coord_x, const double coord_y, const double coord_z);
 		bool isObsFree(const double coord_x, const double coord_y, const double coord_z);
+		// every voxel the straight segment crosses is free, stops at the first occupied one
+		bool isSegmentFree(const Eigen::Vector3d & start, const Eigen::Vector3d & end) const;
+		// the swept chords of the trajectory at voxel resolution are free, stops at the first hit
+		bool isTrajectoryFree(const TrajectoryState & trajectory) const;
 				
 		Eigen::Vector3d coordRounding(const Eigen::Vector3d & coord);
 		double OptimalBVP(Eigen::Vector3d _start_position,Eigen::Vector3d _start_velocity,Eigen::Vector3d _target_position);
+		// OptimalBVP of n start states given as arrays per coordinate, all towards the same target
+		void OptimalBVPBatch(int n, const double * pos_x, const double * pos_y, const double * pos_z,
+		                     const double * vel_x, const double * vel_y, const double * vel_z,
+		                     Eigen::Vector3d _target_position, double * cost) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef _HYBRID_ASTAR_H_
+#define _HYBRID_ASTAR_H_
+
+#include <Eigen/Eigen>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <hw_tool.h>
+#include <State.h>
+
+struct KinoNode;
+typedef KinoNode* KinoNodePtr;
+
+struct KinoNode
+{
+    int id;        // 1--> open set, -1 --> closed set
+    Eigen::Vector3d position, velocity;
+    Eigen::Vector3d input;  // acceleration of the primitive from cameFrom
+    double duration;
+
+    double gScore, fScore;
+    KinoNodePtr cameFrom;
+    std::multimap<double, KinoNodePtr>::iterator nodeMapIt;
+};
+
+/*
+    Kinodynamic hybrid A* over constant acceleration primitives of duration tau. Nodes live in a hashed grid
+    over position and velocity cells, a primitive ending in an occupied cell only replaces that node if it
+    reaches it cheaper. The edge cost is tau (1 + |a|^2), the cost OptimalBVP minimizes, and the OptimalBVP
+    cost to the goal at rest is the heuristic. Every expansion also tries that OBVP trajectory itself as a
+    shortcut to the goal and stops once it is feasible.
+*/
+class HybridAstar
+{
+    public:
+        struct Param
+        {
+            double max_vel, max_acc;
+            int acc_steps;          // inputs per axis, from -max_acc to max_acc
+            double tau;             // duration of a primitive
+            double pos_resolution, vel_resolution;
+            double lambda_heu;      // weight of the heuristic, > 1 trades optimality for speed
+            int max_nodes;
+            double shot_dt;         // sampling of the analytic shortcut for its collision check
+        };
+
+        HybridAstar(){};
+        ~HybridAstar(){};
+
+        void init(Homeworktool * _homework_tool, const Eigen::Vector3d & map_lower, const Eigen::Vector3d & map_upper, const Param & _param);
+        bool search(const Eigen::Vector3d & start_pt, const Eigen::Vector3d & start_velocity, const Eigen::Vector3d & target_pt);
+
+        // the primitives from the start and the shortcut
+        std::vector<TrajectoryState> getTrajectory() const;
+        double getCost() const { return cost; }
+        int getExpandedNum() const { return expanded_num; }
+        int getNodeNum() const { return node_num; }
+
+    private:
+        Homeworktool * homework_tool;
+        Eigen::Vector3d map_lower, map_upper;
+        Param param;
+        std::vector<Eigen::Vector3d> inputs;
+
+        // node pool, reserved once so the pointers stay valid
+        std::vector<KinoNode> node_pool;
+        int node_num;
+        std::unordered_map<int64_t, KinoNodePtr> node_grid;
+        std::multimap<double, KinoNodePtr> openSet;
+
+        KinoNodePtr terminatePtr;
+        Eigen::Matrix<double, 4, 3> shot_coeff;
+        double shot_T, cost;
+        int expanded_num;
+
+        int64_t stateKey(const Eigen::Vector3d & pos, const Eigen::Vector3d & vel) const;
+        bool isPrimitiveFree(const Eigen::Vector3d & pos, const Eigen::Vector3d & vel, const Eigen::Vector3d & acc, double duration) const;
+        bool tryShot(KinoNodePtr node, const Eigen::Vector3d & target_pt);
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef _OBVP_SOLVER_H_
+#define _OBVP_SOLVER_H_
+
+#include <Eigen/Eigen>
+
+/*
+    Optimal boundary value problem of a double integrator (input: acceleration) with fixed final
+    position and velocity and free final time T, minimizing
+
+        J = T + integral_0^T |a(t)|^2 dt
+
+    With dp = p_f - p_0, a = |v_0|^2 + v_0.v_f + |v_f|^2, b = dp.(v_0 + v_f), c = |dp|^2 the optimal
+    cost for a given T is J(T) = T + 4a / T - 12b / T^2 + 12c / T^3, and dJ/dT = 0 is the depressed quartic
+
+        T^4 - 4a T^2 + 24b T - 36c = 0
+
+    which is solved in closed form (Ferrari), no allocation and no eigenvalue solve. The batched version finds
+    a root of the resolvent cubic by safeguarded Newton instead, which vectorizes.
+
+    The general Problem adds a time weight rho, J = rho T + integral_0^T |u(t)|^2 dt, the triple integrator
+    (input: jerk) and free final velocity or acceleration, whose costates vanish at T instead. For a given T
+    the input is closed form in every variant; the stationary condition is a depressed quartic for the
+    double integrator, solved like above, and a degree 6 polynomial without T^5 term for the triple
+    integrator, whose real roots are isolated between those of its derivatives.
+*/
+namespace obvp
+{
+    struct Solution
+    {
+        double T;
+        double cost;
+        // per axis p(t) = coeff(0, i) t^3 + coeff(1, i) t^2 + coeff(2, i) t + coeff(3, i), t in [0, T]
+        Eigen::Matrix<double, 4, 3> coeff;
+    };
+
+    // real roots of x^3 + a2 x^2 + a1 x + a0, returns their number (1 or 3)
+    int solveCubic(double a2, double a1, double a0, double roots[3]);
+    // real roots of x^4 + p x^2 + q x + r, returns their number
+    int solveDepressedQuartic(double p, double q, double r, double roots[4]);
+
+    double cost(double a, double b, double c, double T);
+
+    // false if no positive stationary T exists, i.e. start and end state coincide at rest
+    bool solve(const Eigen::Vector3d &p_0, const Eigen::Vector3d &v_0,
+               const Eigen::Vector3d &p_f, const Eigen::Vector3d &v_f, Solution &sol);
+
+    struct Problem
+    {
+        int order;                      // 2: double integrator, input acceleration; 3: triple integrator, input jerk
+        Eigen::Vector3d p_0, v_0, a_0;  // a_0 and a_f are only used by the triple integrator
+        Eigen::Vector3d p_f, v_f, a_f;
+        bool fix_v_f, fix_a_f;
+        double rho;                     // weight of T, > 0
+    };
+
+    struct PolySolution
+    {
+        double T;
+        double cost;
+        // per axis p(t) = sum_k coeff(k, i) t^(5 - k), t in [0, T]; the double integrator leaves the first two rows zero
+        Eigen::Matrix<double, 6, 3> coeff;
+    };
+
+    // optimal trajectory and cost for the fixed duration T
+    double evaluate(const Problem &problem, double T, PolySolution &sol);
+
+    // false if no positive stationary T exists, i.e. nothing has to move
+    bool solve(const Problem &problem, PolySolution &sol);
+
+    // optimal T and cost from n start states in structure of arrays layout to one shared end state, T = -1
+    // and cost = inf where solve would fail. Runs four states per AVX2 vector when the CPU has it.
+    void solveBatch(int n, const double *p_x, const double *p_y, const double *p_z,
+                    const double *v_x, const double *v_y, const double *v_z,
+                    const Eigen::Vector3d &p_f, const Eigen::Vector3d &v_f, double *T, double *cost);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _PRIMITIVE_LIBRARY_H_
+#define _PRIMITIVE_LIBRARY_H_
+
+#include <Eigen/Eigen>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Constant acceleration primitives of the trajectory lattice. Their shape only depends on the start
+    velocity and the input set, not on the start position, so their end states are evaluated once per
+    quantized start velocity, relative to the start position. The primitives themselves are exact
+    quadratics, see TrajectoryState::setPrimitive.
+*/
+class PrimitiveLibrary
+{
+    public:
+        // all primitives of one quantized start velocity
+        struct Shapes
+        {
+            Eigen::Vector3d start_velocity;
+            // end state of every primitive, one array per coordinate for the batched OBVP
+            std::vector<double> end_px, end_py, end_pz, end_vx, end_vy, end_vz;
+        };
+
+        PrimitiveLibrary(){};
+        ~PrimitiveLibrary(){};
+
+        void init(double max_input_acc, int discretize_step, double time_interval, int time_step, double velocity_resolution);
+
+        // evaluates on the first query of a quantized velocity only
+        const Shapes & getShapes(const Eigen::Vector3d & start_velocity);
+
+        Eigen::Vector3d getInput(int i, int j, int k) const;
+        int getPrimitiveNum() const { return (discretize_step + 1) * (discretize_step + 1) * (discretize_step + 1); }
+        // the sampled primitives used to run one step past time_interval, kept so the end states do not change
+        double getDuration() const { return time_interval * (time_step + 1) / double(time_step); }
+        int getPrimitiveIndex(int i, int j, int k) const { return (i * (discretize_step + 1) + j) * (discretize_step + 1) + k; }
+
+        size_t getHitNum() const { return hit_num; }
+        size_t getMissNum() const { return miss_num; }
+
+    private:
+        double max_input_acc, time_interval, velocity_resolution;
+        int discretize_step, time_step;
+
+        std::unordered_map<int64_t, Shapes> shapes;
+        size_t hit_num = 0, miss_num = 0;
+
+        void evaluate(const Eigen::Vector3d & start_velocity, Shapes & result) const;
+};
+
+#endif
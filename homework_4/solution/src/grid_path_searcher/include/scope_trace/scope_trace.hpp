@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+Scoped timing zones for the planning nodes, written as Chrome trace events (chrome://tracing, Perfetto,
+speedscope) for offline flame graphs.
+
+  SCOPE_TRACE_ZONE("A*");          // times the rest of the enclosing scope
+  SCOPE_TRACE_FUNCTION();          // same, named after the function
+  scope_trace::setEnabled(true);   // off by default
+  scope_trace::dump("/tmp/plan_trace.json");
+
+Every thread records its finished zones into its own ring buffer, the owning thread is the only writer
+and publishes an entry with one release store, so recording takes no lock. Registering a thread's buffer,
+once, and dumping take a mutex. A full ring overwrites its oldest zones. While disabled a zone costs one
+relaxed atomic load; defining SCOPE_TRACE_DISABLE removes the zones at compile time.
+*/
+namespace scope_trace {
+
+struct Event {
+  const char* name;  // string literal, not copied
+  int64_t begin_ns;
+  int64_t end_ns;
+  int depth;
+};
+
+class ThreadBuffer {
+ public:
+  static const size_t kCapacity = 1 << 16;
+
+  explicit ThreadBuffer(int tid) : tid_(tid), depth_(0), head_(0), events_(new Event[kCapacity]) {}
+
+  int tid() const {
+    return tid_;
+  }
+  int& depth() {
+    return depth_;
+  }
+  void push(const Event& event) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    events_[head & (kCapacity - 1)] = event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+  // the zones still in the ring, oldest first; entries the writer may have overwritten meanwhile are dropped
+  void snapshot(std::vector<Event>& out) const {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t first = head > kCapacity ? head - kCapacity : 0;
+    size_t offset = out.size();
+    for (uint64_t i = first; i < head; ++i) {
+      out.push_back(events_[i & (kCapacity - 1)]);
+    }
+    uint64_t head_after = head_.load(std::memory_order_acquire);
+    uint64_t valid = head_after > kCapacity ? head_after - kCapacity : 0;
+    if (valid > first) {
+      size_t drop = std::min<uint64_t>(valid - first, head - first);
+      out.erase(out.begin() + offset, out.begin() + offset + drop);
+    }
+  }
+
+ private:
+  int tid_;
+  int depth_;
+  std::atomic<uint64_t> head_;
+  std::unique_ptr<Event[]> events_;
+};
+
+class Registry {
+ public:
+  static Registry& instance() {
+    static Registry registry;
+    return registry;
+  }
+  std::atomic<bool>& enabled() {
+    return enabled_;
+  }
+  ThreadBuffer* add() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.emplace_back(new ThreadBuffer(buffers_.size()));
+    return buffers_.back().get();
+  }
+  template <class F>
+  void forEach(F f) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& buffer : buffers_) {
+      f(*buffer);
+    }
+  }
+
+ private:
+  Registry() : enabled_(false) {}
+  std::atomic<bool> enabled_;
+  std::mutex mutex_;
+  // buffers outlive their threads, so zones of finished worker threads are still dumped
+  std::vector<std::unique_ptr<ThreadBuffer> > buffers_;
+};
+
+inline int64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline ThreadBuffer* threadBuffer() {
+  static thread_local ThreadBuffer* buffer = Registry::instance().add();
+  return buffer;
+}
+
+inline void setEnabled(bool enabled) {
+  Registry::instance().enabled().store(enabled, std::memory_order_relaxed);
+}
+
+inline bool isEnabled() {
+  return Registry::instance().enabled().load(std::memory_order_relaxed);
+}
+
+class Zone {
+ public:
+  explicit Zone(const char* name) : buffer_(nullptr) {
+    if (!isEnabled()) {
+      return;
+    }
+    buffer_ = threadBuffer();
+    name_ = name;
+    depth_ = buffer_->depth()++;
+    begin_ns_ = now();
+  }
+  ~Zone() {
+    if (buffer_ == nullptr) {
+      return;
+    }
+    Event event = {name_, begin_ns_, now(), depth_};
+    buffer_->depth()--;
+    buffer_->push(event);
+  }
+
+ private:
+  Zone(const Zone&) = delete;
+  Zone& operator=(const Zone&) = delete;
+  ThreadBuffer* buffer_;
+  const char* name_;
+  int64_t begin_ns_;
+  int depth_;
+};
+
+// Chrome trace event JSON of all recorded zones, complete events ("ph": "X") with microsecond times
+inline bool dump(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  fprintf(file, "{\"traceEvents\":[");
+  bool first = true;
+  std::vector<Event> events;
+  Registry::instance().forEach([&](const ThreadBuffer& buffer) {
+    events.clear();
+    buffer.snapshot(events);
+    for (const Event& event : events) {
+      fprintf(file, "%s\n{\"name\":\"", first ? "" : ",");
+      // names are identifiers or short literals, only the JSON specials are escaped
+      for (const char* c = event.name; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+          fputc('\\', file);
+        }
+        fputc(*c, file);
+      }
+      fprintf(file, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%d}}", buffer.tid(),
+              event.begin_ns * 1e-3, (event.end_ns - event.begin_ns) * 1e-3, event.depth);
+      first = false;
+    }
+  });
+  fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  return fclose(file) == 0;
+}
+
+}  // namespace scope_trace
+
+#define SCOPE_TRACE_CONCAT_(a, b) a##b
+#define SCOPE_TRACE_CONCAT(a, b) SCOPE_TRACE_CONCAT_(a, b)
+#ifdef SCOPE_TRACE_DISABLE
+#define SCOPE_TRACE_ZONE(name) ((void)0)
+#else
+#define SCOPE_TRACE_ZONE(name) scope_trace::Zone SCOPE_TRACE_CONCAT(scope_trace_zone_, __LINE__)(name)
+#endif
+#define SCOPE_TRACE_FUNCTION() SCOPE_TRACE_ZONE(__func__)
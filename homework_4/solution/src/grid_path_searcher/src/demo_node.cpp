@@ -15,6 +15,9 @@
 #include <visualization_msgs/Marker.h>
 
 #include <hw_tool.h>
+#include <primitive_library.h>
+#include <hybrid_astar.h>
+#include <scope_trace/scope_trace.hpp>
 #include "backward.hpp"
 
 using namespace std;
@@ -37,21 +40,29 @@ int _max_x_id, _max_y_id, _max_z_id;
 
 // ros related
 ros::Subscriber _map_sub, _pts_sub;
-ros::Publisher  _grid_map_vis_pub, _path_vis_pub;
+ros::Publisher  _grid_map_vis_pub, _path_vis_pub, _kino_path_vis_pub;
 
 // Integral parameter
 double _max_input_acc     = 1.0;
 int    _discretize_step   = 2;
 double _time_interval     = 1.25;
 int    _time_step         = 50;
+double _velocity_resolution;
 
 Homeworktool * _homework_tool     = new Homeworktool();
 TrajectoryStatePtr *** TraLibrary;
+PrimitiveLibrary _primitive_library;
+vector<double> _primitive_cost;
+
+// kinodynamic search over the same input set, with the OBVP to the target as heuristic and shortcut
+HybridAstar _hybrid_astar;
+HybridAstar::Param _search_param;
 
 void rcvWaypointsCallback(const nav_msgs::Path & wp);
 void rcvPointCloudCallBack(const sensor_msgs::PointCloud2 & pointcloud_map);
 void trajectoryLibrary(const Eigen::Vector3d start_pt, const Eigen::Vector3d start_velocity, const Eigen::Vector3d target_pt);
 void visTraLibrary(TrajectoryStatePtr *** TraLibrary);
+void visKinoPath(const vector<TrajectoryState> & trajectory);
 
 void rcvWaypointsCallback(const nav_msgs::Path & wp)
 {     
@@ -65,6 +76,17 @@ void rcvWaypointsCallback(const nav_msgs::Path & wp)
 
     ROS_INFO("[node] receive the planning target");
     trajectoryLibrary(_start_pt,_start_velocity,target_pt);
+
+    ros::Time time_1 = ros::Time::now();
+    bool found = _hybrid_astar.search(_start_pt, _start_velocity, target_pt);
+    ros::Time time_2 = ros::Time::now();
+    if(found){
+        ROS_INFO("[hybrid A*] time: %f ms, expanded %d of %d nodes, cost %f", (time_2 - time_1).toSec() * 1000.0,
+                 _hybrid_astar.getExpandedNum(), _hybrid_astar.getNodeNum(), _hybrid_astar.getCost());
+        visKinoPath(_hybrid_astar.getTrajectory());
+    }else{
+        ROS_WARN("[hybrid A*] no trajectory found, time: %f ms, expanded %d nodes", (time_2 - time_1).toSec() * 1000.0, _hybrid_astar.getExpandedNum());
+    }
 }
 
 void rcvPointCloudCallBack(const sensor_msgs::PointCloud2 & pointcloud_map)
@@ -109,104 +131,84 @@ void rcvPointCloudCallBack(const sensor_msgs::PointCloud2 & pointcloud_map)
 
 void trajectoryLibrary(const Vector3d start_pt, const Vector3d start_velocity, const Vector3d target_pt)
 {
-    Vector3d acc_input;
-    Vector3d pos,vel;
+    SCOPE_TRACE_FUNCTION();
     int a =0 ;
     int b =0 ;
     int c =0 ;
 
     double min_Cost = 100000.0;
-    double Trajctory_Cost;
-    TraLibrary  = new TrajectoryStatePtr ** [_discretize_step + 1];     //recored all trajectories after input
-
-    for(int i=0; i <= _discretize_step; i++){           //acc_input_ax
-        TraLibrary[i] = new TrajectoryStatePtr * [_discretize_step + 1];
-        for(int j=0;j <= _discretize_step; j++){        //acc_input_ay
-            TraLibrary[i][j] = new TrajectoryStatePtr [_discretize_step + 1];
-            for(int k=0; k <= _discretize_step; k++){   //acc_input_az
-                
-                
-                vector<Vector3d> Position;
-                vector<Vector3d> Velocity;
-                acc_input(0) = double(-_max_input_acc + i * (2 * _max_input_acc / double(_discretize_step)) );
-                acc_input(1) = double(-_max_input_acc + j * (2 * _max_input_acc / double(_discretize_step)) );
-                acc_input(2) = double( k * (2 * _max_input_acc / double(_discretize_step) ) + 0.1);                          //acc_input_az >0.1
-                
-                pos(0) = start_pt(0);
-                pos(1) = start_pt(1);
-                pos(2) = start_pt(2);
-                vel(0) = start_velocity(0);
-                vel(1) = start_velocity(1);
-                vel(2) = start_velocity(2);
-                Position.push_back(pos);
-                Velocity.push_back(vel);
-
-                bool collision = false;
-                double delta_time;
-                delta_time = _time_interval / double(_time_step);
-                
-                for(int step=0 ; step<=_time_step ; step ++){
-
-                    /*
-                    
-
-
-
-                    STEP 1: finish the forward integration, the modelling has been given in the document
-                    the parameter of forward integration: _max_input_acc|_discretize_step|_time_interval|_time_step   all have been given
-                    use the pos and vel to recored the steps in the trakectory
-
-
-
-                    */
-
-                    pos += delta_time*vel + 0.5*acc_input*delta_time*delta_time;
-                    vel += delta_time*acc_input;
-
-                    Position.push_back(pos);
-                    Velocity.push_back(vel);
-                    double coord_x = pos(0);
-                    double coord_y = pos(1);
-                    double coord_z = pos(2);
-                    //check if if the trajectory face the obstacle
-                    if(_homework_tool->isObsFree(coord_x,coord_y,coord_z) != 1){
-                        collision = true;
-                    }
-                }
-                /*
-                    
-
-
-
-                    STEP 2: go to the hw_tool.cpp and finish the function Homeworktool::OptimalBVP
-                    the solving process has been given in the document
-
-                    because the final point of trajectory is the start point of OBVP, so we input the pos,vel to the OBVP
 
-                    after finish Homeworktool::OptimalBVP, the Trajctory_Cost will record the optimal cost of this trajectory
+    // the primitive end states are stored relative to the start, the library evaluates them for a new start velocity only
+    const PrimitiveLibrary::Shapes & shapes = _primitive_library.getShapes(start_velocity);
+    double duration = _primitive_library.getDuration();
+
+    // primitives are handled in chunks: each thread collision checks a chunk, solves its OBVPs in one pass
+    // and keeps its own best primitive, the threads' bests are reduced at the end. A primitive only writes
+    // its own state and cost slot
+    int primitive_num = _primitive_library.getPrimitiveNum();
+    const int chunk = 32;
+    int best_primitive = -1;
+    #pragma omp parallel if(primitive_num >= 64)
+    {
+        int    thread_best = -1;
+        double thread_cost = 100000.0;
+
+        #pragma omp for schedule(dynamic)
+        for(int first = 0; first < primitive_num; first += chunk){
+            SCOPE_TRACE_ZONE("primitive chunk");
+            int last = min(first + chunk, primitive_num);
+            for(int primitive = first; primitive < last; primitive++){
+                int i = primitive / ((_discretize_step + 1) * (_discretize_step + 1));      //acc_input_ax
+                int j = primitive / (_discretize_step + 1) % (_discretize_step + 1);        //acc_input_ay
+                int k = primitive % (_discretize_step + 1);                                  //acc_input_az
+
+                //the primitive is the exact quadratic, from the same quantized start velocity as its end state
+                TrajectoryStatePtr state = TraLibrary[i][j][k];
+                state->setPrimitive(start_pt, shapes.start_velocity, _primitive_library.getInput(i, j, k), duration);
+                state->collision_check = false;
+                state->optimal_flag    = false;
+
+                //the curve is checked in voxel sized pieces, not only at some samples
+                //if there is not any obstacle in the trajectory we need to set 'collision_check = true', so this trajectory is useable
+                if(!_homework_tool->isTrajectoryFree(*state))
+                    state->setCollisionfree();
+            }
 
+            // the OBVP only depends on the target relative to the primitive ends, which are stored relative to the start
+            _homework_tool -> OptimalBVPBatch(last - first, &shapes.end_px[first], &shapes.end_py[first], &shapes.end_pz[first],
+                                              &shapes.end_vx[first], &shapes.end_vy[first], &shapes.end_vz[first],
+                                              target_pt - start_pt, &_primitive_cost[first]);
 
-                */
-                Trajctory_Cost = _homework_tool -> OptimalBVP(pos,vel,target_pt);
+            for(int primitive = first; primitive < last; primitive++){
+                int i = primitive / ((_discretize_step + 1) * (_discretize_step + 1));
+                int j = primitive / (_discretize_step + 1) % (_discretize_step + 1);
+                int k = primitive % (_discretize_step + 1);
+                double Trajctory_Cost = _primitive_cost[primitive];
+                TraLibrary[i][j][k]->Trajctory_Cost = Trajctory_Cost;
 
-                //input the trajetory in the trajectory library
-                TraLibrary[i][j][k] = new TrajectoryState(Position,Velocity,Trajctory_Cost);
-                
-                //if there is not any obstacle in the trajectory we need to set 'collision_check = true', so this trajectory is useable
-                if(collision)
-                    TraLibrary[i][j][k]->setCollisionfree();
-                
                 //record the min_cost in the trajectory Library, and this is the part pf selecting the best trajectory cloest to the planning traget
-                if(Trajctory_Cost<min_Cost && TraLibrary[i][j][k]->collision_check == false){
-                    a = i;
-                    b = j;
-                    c = k;
-                    min_Cost = Trajctory_Cost;
+                if(Trajctory_Cost < thread_cost && TraLibrary[i][j][k]->collision_check == false){
+                    thread_best = primitive;
+                    thread_cost = Trajctory_Cost;
                 }
             }
         }
+
+        // a thread gets its chunks in order, ties between threads go to the lower index, so the choice
+        // does not depend on the thread count
+        #pragma omp critical
+        if(thread_best >= 0 && (thread_cost < min_Cost || (thread_cost == min_Cost && thread_best < best_primitive))){
+            best_primitive = thread_best;
+            min_Cost       = thread_cost;
+        }
+    }
+    if(best_primitive >= 0){
+        a = best_primitive / ((_discretize_step + 1) * (_discretize_step + 1));
+        b = best_primitive / (_discretize_step + 1) % (_discretize_step + 1);
+        c = best_primitive % (_discretize_step + 1);
     }
     TraLibrary[a][b][c] -> setOptimal();
+    ROS_INFO("[node] primitive library: %lu hits, %lu misses", _primitive_library.getHitNum(), _primitive_library.getMissNum());
     visTraLibrary(TraLibrary);
     return;
 }
@@ -221,6 +223,7 @@ int main(int argc, char** argv)
 
     _grid_map_vis_pub         = nh.advertise<sensor_msgs::PointCloud2>("grid_map_vis", 1);
     _path_vis_pub             = nh.advertise<visualization_msgs::MarkerArray>("RRTstar_path_vis",1);
+    _kino_path_vis_pub        = nh.advertise<visualization_msgs::MarkerArray>("kino_path_vis",1);
 
     nh.param("map/cloud_margin",  _cloud_margin, 0.0);
     nh.param("map/resolution",    _resolution,   0.2);
@@ -236,6 +239,24 @@ int main(int argc, char** argv)
     nh.param("planning/start_vx",  _start_velocity(0),  0.0);
     nh.param("planning/start_vy",  _start_velocity(1),  0.0);
     nh.param("planning/start_vz",  _start_velocity(2),  0.0);    
+
+    nh.param("planning/velocity_resolution", _velocity_resolution, 0.01);
+
+    nh.param("search/max_vel",        _search_param.max_vel,        2.0);
+    nh.param("search/max_acc",        _search_param.max_acc,        _max_input_acc);
+    nh.param("search/acc_steps",      _search_param.acc_steps,      _discretize_step + 1);
+    nh.param("search/tau",            _search_param.tau,            0.8);
+    nh.param("search/pos_resolution", _search_param.pos_resolution, 0.4);
+    nh.param("search/vel_resolution", _search_param.vel_resolution, 0.5);
+    nh.param("search/lambda_heu",     _search_param.lambda_heu,     2.0);
+    nh.param("search/max_nodes",      _search_param.max_nodes,      100000);
+    nh.param("search/shot_dt",        _search_param.shot_dt,        0.05);
+
+    bool trace_enable;
+    string trace_output;
+    nh.param("trace/enable", trace_enable, false);
+    nh.param("trace/output", trace_output, string("/tmp/demo_node_trace.json"));
+    scope_trace::setEnabled(trace_enable);
     
     _map_lower << - _x_size/2.0, - _y_size/2.0,     0.0;
     _map_upper << + _x_size/2.0, + _y_size/2.0, _z_size;
@@ -248,6 +269,20 @@ int main(int argc, char** argv)
 
     _homework_tool  = new Homeworktool();
     _homework_tool  -> initGridMap(_resolution, _map_lower, _map_upper, _max_x_id, _max_y_id, _max_z_id);
+
+    _hybrid_astar.init(_homework_tool, _map_lower, _map_upper, _search_param);
+
+    _primitive_library.init(_max_input_acc, _discretize_step, _time_interval, _time_step, _velocity_resolution);
+    _primitive_cost.resize(_primitive_library.getPrimitiveNum());
+    TraLibrary  = new TrajectoryStatePtr ** [_discretize_step + 1];     //recored all trajectories after input
+    for(int i=0; i <= _discretize_step; i++){
+        TraLibrary[i] = new TrajectoryStatePtr * [_discretize_step + 1];
+        for(int j=0;j <= _discretize_step; j++){
+            TraLibrary[i][j] = new TrajectoryStatePtr [_discretize_step + 1];
+            for(int k=0; k <= _discretize_step; k++)
+                TraLibrary[i][j][k] = new TrajectoryState();
+        }
+    }
     
     ros::Rate rate(100);
     bool status = ros::ok();
@@ -257,7 +292,18 @@ int main(int argc, char** argv)
         status = ros::ok();
         rate.sleep();
     }
-
+    if(trace_enable && scope_trace::dump(trace_output))
+        ROS_INFO("[node] trace written to %s", trace_output.c_str());
+
+    for(int i=0; i <= _discretize_step; i++){
+        for(int j=0;j <= _discretize_step; j++){
+            for(int k=0; k <= _discretize_step; k++)
+                delete TraLibrary[i][j][k];
+            delete [] TraLibrary[i][j];
+        }
+        delete [] TraLibrary[i];
+    }
+    delete [] TraLibrary;
     delete _homework_tool;
     return 0;
 }
@@ -282,6 +328,7 @@ void visTraLibrary(TrajectoryStatePtr *** TraLibrary)
     Line.color.a         = 1.0;
 
     int marker_id = 0;
+    vector<Vector3d> samples;
 
     for(int i = 0; i <= _discretize_step; i++){
         for(int j = 0; j<= _discretize_step;j++){  
@@ -307,17 +354,54 @@ void visTraLibrary(TrajectoryStatePtr *** TraLibrary)
                    Line.points.clear();
                     geometry_msgs::Point pt;
                     Line.id = marker_id;
-                    for(int index = 0; index < int(TraLibrary[i][j][k]->Position.size());index++){
-                        Vector3d coord = TraLibrary[i][j][k]->Position[index];
+                    TraLibrary[i][j][k]->samplePosition(_time_interval / double(_time_step), samples);
+                    for(int index = 0; index < int(samples.size());index++){
+                        Vector3d coord = samples[index];
                         pt.x = coord(0);
                         pt.y = coord(1);
                         pt.z = coord(2);
                         Line.points.push_back(pt);
                     }
                     LineArray.markers.push_back(Line);
-                    _path_vis_pub.publish(LineArray);
                     ++marker_id; 
             }
         }
-    }    
-}
\ No newline at end of file
+    }
+    // one message for the whole library
+    _path_vis_pub.publish(LineArray);
+}
+
+void visKinoPath(const vector<TrajectoryState> & trajectory)
+{
+    visualization_msgs::MarkerArray  LineArray;
+    visualization_msgs::Marker       Line;
+
+    Line.header.frame_id = "world";
+    Line.header.stamp    = ros::Time::now();
+    Line.ns              = "demo_node/KinoPath";
+    Line.action          = visualization_msgs::Marker::ADD;
+    Line.pose.orientation.w = 1.0;
+    Line.type            = visualization_msgs::Marker::LINE_STRIP;
+    Line.scale.x         = _resolution/3;
+
+    Line.color.r         = 1.0;
+    Line.color.g         = 0.5;
+    Line.color.b         = 0.0;
+    Line.color.a         = 1.0;
+
+    // a single strip through all pieces, the old one is replaced by its id
+    Line.id = 0;
+    geometry_msgs::Point pt;
+    vector<Vector3d> samples;
+    for(const TrajectoryState & piece : trajectory){
+        piece.samplePosition(0.05, samples);
+        for(const Vector3d & coord : samples){
+            pt.x = coord(0);
+            pt.y = coord(1);
+            pt.z = coord(2);
+            Line.points.push_back(pt);
+        }
+    }
+    LineArray.markers.push_back(Line);
+    _kino_path_vis_pub.publish(LineArray);
+}
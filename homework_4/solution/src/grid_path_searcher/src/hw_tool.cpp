@@ -1,5 +1,7 @@
 #include <hw_tool.h>
-#include <unsupported/Eigen/Polynomials>
+#include <obvp_solver.h>
+#include <scope_trace/scope_trace.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace Eigen;
@@ -58,6 +60,64 @@ bool Homeworktool::isObsFree(const double coord_x, const double coord_y, const d
            (data[idx_x * GLYZ_SIZE + idx_y * GLZ_SIZE + idx_z] < 1));
 }
 
+bool Homeworktool::isOccupiedIndex(int idx_x, int idx_y, int idx_z) const
+{
+    idx_x = min(max(idx_x, 0), GLX_SIZE - 1);
+    idx_y = min(max(idx_y, 0), GLY_SIZE - 1);
+    idx_z = min(max(idx_z, 0), GLZ_SIZE - 1);
+    return data[idx_x * GLYZ_SIZE + idx_y * GLZ_SIZE + idx_z] >= 1;
+}
+
+bool Homeworktool::isSegmentFree(const Vector3d & start, const Vector3d & end) const
+{
+    // Amanatides-Woo walk in grid units from the voxel of start to the voxel of end
+    Vector3d origin(gl_xl, gl_yl, gl_zl);
+    Vector3d p0 = (start - origin) * inv_resolution;
+    Vector3d p1 = (end - origin) * inv_resolution;
+    Vector3d dir = p1 - p0;
+
+    int idx[3], step[3], step_num = 0;
+    double t_max[3], t_delta[3];
+    for(int i = 0; i < 3; i++){
+        idx[i] = (int)floor(p0(i));
+        int end_idx = (int)floor(p1(i));
+        step_num += abs(end_idx - idx[i]);
+        if(end_idx == idx[i]){
+            step[i]    = 0;
+            t_max[i]   = INFINITY;
+            t_delta[i] = INFINITY;
+        }else{
+            step[i]    = dir(i) > 0 ? 1 : -1;
+            t_delta[i] = 1.0 / fabs(dir(i));
+            t_max[i]   = ((dir(i) > 0 ? idx[i] + 1 : idx[i]) - p0(i)) / dir(i);
+        }
+    }
+
+    for(int s = 0; ; s++){
+        if(isOccupiedIndex(idx[0], idx[1], idx[2]))
+            return false;
+        if(s == step_num)
+            return true;
+        int axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+        idx[axis]   += step[axis];
+        t_max[axis] += t_delta[axis];
+    }
+}
+
+bool Homeworktool::isTrajectoryFree(const TrajectoryState & trajectory) const
+{
+    // pieces no longer than a voxel, so their chords stay within the voxels the curve passes
+    int piece_num = max(1, (int)ceil(trajectory.getMaxSpeed() * trajectory.duration * inv_resolution));
+    Vector3d last = trajectory.getPosition(0.0);
+    for(int i = 1; i <= piece_num; i++){
+        Vector3d next = trajectory.getPosition(trajectory.duration * i / piece_num);
+        if(!isSegmentFree(last, next))
+            return false;
+        last = next;
+    }
+    return true;
+}
+
 Vector3d Homeworktool::gridIndex2coord(const Vector3i & index) 
 {
     Vector3d pt;
@@ -102,92 +162,28 @@ double Homeworktool::OptimalBVP(Eigen::Vector3d _start_position,Eigen::Vector3d
 
     */
 
-    auto p_x_0 = _start_position.x();
-    auto p_y_0 = _start_position.y();
-    auto p_z_0 = _start_position.z();
-
-    auto p_x_0_sq = p_x_0 * p_x_0;
-    auto p_y_0_sq = p_y_0 * p_y_0;
-    auto p_z_0_sq = p_z_0 * p_z_0;
-    
-    auto v_x_0 = _start_velocity.x();
-    auto v_y_0 = _start_velocity.y();
-    auto v_z_0 = _start_velocity.z();
-
-    auto v_x_0_sq = v_x_0 * v_x_0;
-    auto v_y_0_sq = v_y_0 * v_y_0;
-    auto v_z_0_sq = v_z_0 * v_z_0;
-
-    auto p_x_f = _target_position.x();
-    auto p_y_f = _target_position.y();
-    auto p_z_f = _target_position.z();
-
-    auto p_x_f_sq = p_x_f * p_x_f;
-    auto p_y_f_sq = p_y_f * p_y_f;
-    auto p_z_f_sq = p_z_f * p_z_f;
-
-    
-    auto v_x_f = _start_velocity.x();
-    auto v_y_f = _start_velocity.y();
-    auto v_z_f = _start_velocity.z();
-
-    auto v_x_f_sq = v_x_f * p_x_f;
-    auto v_y_f_sq = v_y_f * p_y_f;
-    auto v_z_f_sq = v_z_f * p_z_f;
-
-    auto cal_cost = [&](const double T) {
-        double cost = (
-            std::pow(T,4) + T * T * (4*v_x_0_sq + 4*v_x_0*v_x_f + 4*v_x_f_sq + 4*v_y_0_sq + 4*v_y_0*v_y_f + 4*v_y_f_sq + 4*v_z_0_sq + 4*v_z_0*v_z_f + 4*v_z_f_sq) + 
-            T * (12*p_x_f*v_x_0 + 12*p_x_0*v_x_f - 12*p_x_0*v_x_0 - 12*p_x_f*v_x_f + 12*p_y_0*v_y_0 + 12*p_y_0*v_y_f - 12*p_y_f*v_y_0 - 12*p_y_f*v_y_f + 12*p_z_0*v_z_0 + 12*p_z_0*v_z_f - 12*p_z_f*v_z_0 - 12*p_z_f*v_z_f) - 
-            12*p_x_0_sq - 24*p_x_0*p_x_f + 12*p_x_f_sq + 12*p_y_0_sq - 24*p_y_0*p_y_f + 12*p_y_f_sq + 12*p_z_0_sq - 24*p_z_0*p_z_f + 12*p_z_f_sq
-
-        );
-        return cost / std::pow(T, 3);
-    };
-
-    /*J= (T^4 + 
-    (4*v_x_0^2 + 4*v_x_0*v_x_f + 4*v_x_f^2 + 4*v_y_0^2 + 4*v_y_0*v_y_f + 4*v_y_f^2 + 4*v_z_0^2 + 4*v_z_0*v_z_f + 4*v_z_f^2)*T^2 + 
-    (12*p_x_0*v_x_0 + 12*p_x_0*v_x_f - 12*p_x_f*v_x_0 - 12*p_x_f*v_x_f + 12*p_y_0*v_y_0 + 12*p_y_0*v_y_f - 12*p_y_f*v_y_0 - 12*p_y_f*v_y_f + 12*p_z_0*v_z_0 + 12*p_z_0*v_z_f - 12*p_z_f*v_z_0 - 12*p_z_f*v_z_f)*T + 
-    12*p_x_0^2 - 24*p_x_0*p_x_f + 12*p_x_f^2 + 12*p_y_0^2 - 24*p_y_0*p_y_f + 12*p_y_f^2 + 12*p_z_0^2 - 24*p_z_0*p_z_f + 12*p_z_f^2)/T^3
-    */
-
-   // derivative = 0
-   /*
-       c = [1, 
-       - 4*v_x_0^2 - 4*v_x_0*v_x_f - 4*v_x_f^2 - 4*v_y_0^2 - 4*v_y_0*v_y_f - 4*v_y_f^2 - 4*v_z_0^2 - 4*v_z_0*v_z_f - 4*v_z_f^2, 
-       24*p_x_f*v_x_0 - 24*p_x_0*v_x_f - 24*p_x_0*v_x_0 + 24*p_x_f*v_x_f - 24*p_y_0*v_y_0 - 24*p_y_0*v_y_f + 24*p_y_f*v_y_0 + 24*p_y_f*v_y_f - 24*p_z_0*v_z_0 - 24*p_z_0*v_z_f + 24*p_z_f*v_z_0 + 24*p_z_f*v_z_f, 
-       - 36*p_x_0^2 + 72*p_x_0*p_x_f - 36*p_x_f^2 - 36*p_y_0^2 + 72*p_y_0*p_y_f - 36*p_y_f^2 - 36*p_z_0^2 + 72*p_z_0*p_z_f - 36*p_z_f^2]
- 
-      t =[T^6, T^4, T^3, T^2]
-   */
-
-    Eigen::VectorXd c(7);
-
-    c << 0.0,
-         0.0,
-         -36*p_x_0_sq + 72*p_x_0*p_x_f - 36*p_x_f_sq - 36*p_y_0_sq + 72*p_y_0*p_y_f - 36*p_y_f_sq - 36*p_z_0_sq + 72*p_z_0*p_z_f - 36*p_z_f_sq,
-         24*p_x_0*v_x_0 - 24*p_x_0*v_x_f - 24*p_x_f*v_x_0 + 24*p_x_f*v_x_f - 24*p_y_0*v_y_0 - 24*p_y_0*v_y_f + 24*p_y_f*v_y_0 + 24*p_y_f*v_y_f - 24*p_z_0*v_z_0 - 24*p_z_0*v_z_f + 24*p_z_f*v_z_0 + 24*p_z_f*v_z_f,
-         -4*v_x_0_sq - 4*v_x_0*v_x_f - 4*v_x_f_sq - 4*v_y_0_sq - 4*v_y_0*v_y_f - 4*v_y_f_sq - 4*v_z_0_sq - 4*v_z_0*v_z_f - 4*v_z_f_sq,
-         0.0,
-         1.0;
-
-    Eigen::PolynomialSolver<double, Eigen::Dynamic> solver;
-    solver.compute(c);
-
-    const Eigen::PolynomialSolver<double, Eigen::Dynamic>::RootsType &rt = solver.roots();
+    // the primitive should come to rest on the target
+    obvp::Solution sol;
+    if (obvp::solve(_start_position, _start_velocity, _target_position, Eigen::Vector3d::Zero(), sol))
+        optimal_cost = sol.cost;
 
+    return optimal_cost;
+}
 
-    for (int i = 0; i < rt.rows(); ++ i) {
-        if (rt(i).real() - 0.0 > 1e-6 && std::abs(rt(i).imag()) - 0.0 < 1e-6) {
-
-            auto curr_cost = cal_cost(rt(i).real());
-            optimal_cost = curr_cost < optimal_cost ? curr_cost : optimal_cost;
-
-            std::cout << "curr_cost : " << curr_cost << std::endl;
-        }
-
-        
+void Homeworktool::OptimalBVPBatch(int n, const double * pos_x, const double * pos_y, const double * pos_z,
+                                   const double * vel_x, const double * vel_y, const double * vel_z,
+                                   Eigen::Vector3d _target_position, double * cost) const
+{
+    SCOPE_TRACE_FUNCTION();
+    // the times only mark the lanes without a solution, a buffer on the stack lets threads share the tool
+    const int chunk = 64;
+    double optimal_time[chunk];
+    for (int first = 0; first < n; first += chunk) {
+        int m = std::min(chunk, n - first);
+        obvp::solveBatch(m, pos_x + first, pos_y + first, pos_z + first, vel_x + first, vel_y + first, vel_z + first,
+                         _target_position, Eigen::Vector3d::Zero(), optimal_time, cost + first);
+        for (int i = 0; i < m; ++i)
+            if (optimal_time[i] < 0.0)
+                cost[first + i] = 100000;
     }
-
-    return optimal_cost;
 }
@@ -0,0 +1,230 @@
+#include <hybrid_astar.h>
+#include <obvp_solver.h>
+#include <scope_trace/scope_trace.hpp>
+#include <algorithm>
+
+using namespace std;
+using namespace Eigen;
+
+void HybridAstar::init(Homeworktool * _homework_tool, const Vector3d & _map_lower, const Vector3d & _map_upper, const Param & _param)
+{
+    homework_tool = _homework_tool;
+    map_lower     = _map_lower;
+    map_upper     = _map_upper;
+    param         = _param;
+    param.acc_steps = max(param.acc_steps, 2);
+
+    inputs.clear();
+    double acc_step = 2 * param.max_acc / double(param.acc_steps - 1);
+    for(int i = 0; i < param.acc_steps; i++)
+        for(int j = 0; j < param.acc_steps; j++)
+            for(int k = 0; k < param.acc_steps; k++)
+                inputs.push_back(Vector3d(-param.max_acc + i * acc_step, -param.max_acc + j * acc_step, -param.max_acc + k * acc_step));
+
+    node_pool.resize(param.max_nodes);
+    node_num = 0;
+}
+
+int64_t HybridAstar::stateKey(const Vector3d & pos, const Vector3d & vel) const
+{
+    // 12 bits per position axis, 9 bits per velocity axis
+    int64_t key = 0;
+    int vel_offset = 256;
+    for(int i = 0; i < 3; i++){
+        int64_t pos_idx = min(max(int((pos(i) - map_lower(i)) / param.pos_resolution), 0), 4095);
+        int64_t vel_idx = min(max(int(floor(vel(i) / param.vel_resolution)) + vel_offset, 0), 511);
+        key = (key << 21) | (pos_idx << 9) | vel_idx;
+    }
+    return key;
+}
+
+bool HybridAstar::isPrimitiveFree(const Vector3d & pos, const Vector3d & vel, const Vector3d & acc, double duration) const
+{
+    // samples no further apart than about one voxel, the swept segments between them are checked
+    int sample_num = max(1, (int)ceil(duration * param.max_vel / param.pos_resolution));
+    double dt = duration / sample_num;
+    Vector3d last = pos;
+    for(int i = 1; i <= sample_num; i++){
+        double t = i * dt;
+        Vector3d next = pos + vel * t + 0.5 * acc * t * t;
+        if((next.array() < map_lower.array()).any() || (next.array() >= map_upper.array()).any())
+            return false;
+        if(!homework_tool->isSegmentFree(last, next))
+            return false;
+        last = next;
+    }
+    return true;
+}
+
+bool HybridAstar::tryShot(KinoNodePtr node, const Vector3d & target_pt)
+{
+    SCOPE_TRACE_FUNCTION();
+    obvp::Solution sol;
+    if(!obvp::solve(node->position, node->velocity, target_pt, Vector3d::Zero(), sol)){
+        // already resting on the target
+        shot_T = 0.0;
+        shot_coeff.setZero();
+        shot_coeff.row(3) = node->position.transpose();
+        cost = node->gScore;
+        return true;
+    }
+
+    // the acceleration is linear in t, the velocity quadratic
+    double T = sol.T;
+    const Matrix<double, 4, 3> & c = sol.coeff;
+    for(int i = 0; i < 3; i++){
+        double acc_0 = 2 * c(1, i), acc_T = 6 * c(0, i) * T + 2 * c(1, i);
+        if(fabs(acc_0) > param.max_acc + 1e-6 || fabs(acc_T) > param.max_acc + 1e-6)
+            return false;
+        double vel_T = (3 * c(0, i) * T + 2 * c(1, i)) * T + c(2, i);
+        double vel_max = max(fabs(c(2, i)), fabs(vel_T));
+        if(c(0, i) != 0.0){
+            double t = -c(1, i) / (3 * c(0, i));
+            if(t > 0.0 && t < T)
+                vel_max = max(vel_max, fabs((3 * c(0, i) * t + 2 * c(1, i)) * t + c(2, i)));
+        }
+        if(vel_max > param.max_vel + 1e-6)
+            return false;
+    }
+
+    int sample_num = max(1, (int)ceil(T / param.shot_dt));
+    Vector3d last = node->position;
+    for(int k = 1; k <= sample_num; k++){
+        double t = T * k / sample_num;
+        Vector3d next = (((c.row(0) * t + c.row(1)) * t + c.row(2)) * t + c.row(3)).transpose();
+        if((next.array() < map_lower.array()).any() || (next.array() >= map_upper.array()).any())
+            return false;
+        if(!homework_tool->isSegmentFree(last, next))
+            return false;
+        last = next;
+    }
+    shot_T     = T;
+    shot_coeff = c;
+    cost       = node->gScore + sol.cost;
+    return true;
+}
+
+bool HybridAstar::search(const Vector3d & start_pt, const Vector3d & start_velocity, const Vector3d & target_pt)
+{
+    SCOPE_TRACE_ZONE("hybrid A*");
+    node_num     = 0;
+    expanded_num = 0;
+    terminatePtr = NULL;
+    node_grid.clear();
+    openSet.clear();
+
+    // children of one expansion, one array per coordinate for the batched heuristic
+    int input_num = inputs.size();
+    vector<double> child_px(input_num), child_py(input_num), child_pz(input_num);
+    vector<double> child_vx(input_num), child_vy(input_num), child_vz(input_num);
+    vector<double> child_g(input_num), child_T(input_num), child_h(input_num);
+    vector<int> child_input(input_num);
+    vector<KinoNodePtr> child_existing(input_num);
+
+    KinoNodePtr startPtr = &node_pool[node_num++];
+    startPtr->position = start_pt;
+    startPtr->velocity = start_velocity;
+    startPtr->input    = Vector3d::Zero();
+    startPtr->duration = 0.0;
+    startPtr->gScore   = 0.0;
+    obvp::Solution sol;
+    startPtr->fScore   = obvp::solve(start_pt, start_velocity, target_pt, Vector3d::Zero(), sol) ? param.lambda_heu * sol.cost : 0.0;
+    startPtr->cameFrom = NULL;
+    startPtr->id       = 1;
+    startPtr->nodeMapIt = openSet.insert(make_pair(startPtr->fScore, startPtr));
+    node_grid[stateKey(start_pt, start_velocity)] = startPtr;
+
+    while(!openSet.empty()){
+        KinoNodePtr currentPtr = openSet.begin()->second;
+        openSet.erase(openSet.begin());
+        currentPtr->id = -1;
+        expanded_num++;
+
+        if(tryShot(currentPtr, target_pt)){
+            terminatePtr = currentPtr;
+            return true;
+        }
+
+        int64_t current_key = stateKey(currentPtr->position, currentPtr->velocity);
+        int child_num = 0;
+        for(int i = 0; i < input_num; i++){
+            const Vector3d & acc = inputs[i];
+            double tau = param.tau;
+            Vector3d vel = currentPtr->velocity + acc * tau;
+            if((vel.array().abs() > param.max_vel).any())
+                continue;
+            Vector3d pos = currentPtr->position + currentPtr->velocity * tau + 0.5 * acc * tau * tau;
+            if((pos.array() < map_lower.array()).any() || (pos.array() >= map_upper.array()).any())
+                continue;
+
+            int64_t key = stateKey(pos, vel);
+            if(key == current_key)
+                continue;
+            double gScore = currentPtr->gScore + tau * (1.0 + acc.squaredNorm());
+            auto it = node_grid.find(key);
+            KinoNodePtr existing = it == node_grid.end() ? NULL : it->second;
+            if(existing != NULL && (existing->id == -1 || gScore >= existing->gScore))
+                continue;
+            if(!isPrimitiveFree(currentPtr->position, currentPtr->velocity, acc, tau))
+                continue;
+
+            child_px[child_num] = pos(0), child_py[child_num] = pos(1), child_pz[child_num] = pos(2);
+            child_vx[child_num] = vel(0), child_vy[child_num] = vel(1), child_vz[child_num] = vel(2);
+            child_g[child_num]        = gScore;
+            child_input[child_num]    = i;
+            child_existing[child_num] = existing;
+            child_num++;
+        }
+
+        obvp::solveBatch(child_num, child_px.data(), child_py.data(), child_pz.data(), child_vx.data(), child_vy.data(), child_vz.data(),
+                         target_pt, Vector3d::Zero(), child_T.data(), child_h.data());
+        for(int i = 0; i < child_num; i++){
+            // no stationary time means resting on the target already
+            double fScore = child_g[i] + (child_T[i] > 0.0 ? param.lambda_heu * child_h[i] : 0.0);
+            KinoNodePtr neighborPtr = child_existing[i];
+            if(neighborPtr == NULL){
+                if(node_num == param.max_nodes){
+                    ROS_WARN("[hybrid A*] run out of %d nodes", param.max_nodes);
+                    return false;
+                }
+                neighborPtr = &node_pool[node_num++];
+                node_grid[stateKey(Vector3d(child_px[i], child_py[i], child_pz[i]), Vector3d(child_vx[i], child_vy[i], child_vz[i]))] = neighborPtr;
+            }else{
+                openSet.erase(neighborPtr->nodeMapIt);
+            }
+            neighborPtr->position  = Vector3d(child_px[i], child_py[i], child_pz[i]);
+            neighborPtr->velocity  = Vector3d(child_vx[i], child_vy[i], child_vz[i]);
+            neighborPtr->input     = inputs[child_input[i]];
+            neighborPtr->duration  = param.tau;
+            neighborPtr->gScore    = child_g[i];
+            neighborPtr->fScore    = fScore;
+            neighborPtr->cameFrom  = currentPtr;
+            neighborPtr->id        = 1;
+            neighborPtr->nodeMapIt = openSet.insert(make_pair(fScore, neighborPtr));
+        }
+    }
+    return false;
+}
+
+vector<TrajectoryState> HybridAstar::getTrajectory() const
+{
+    vector<TrajectoryState> trajectory;
+    if(terminatePtr == NULL)
+        return trajectory;
+
+    vector<KinoNodePtr> nodes;
+    for(KinoNodePtr ptr = terminatePtr; ptr->cameFrom != NULL; ptr = ptr->cameFrom)
+        nodes.push_back(ptr);
+    reverse(nodes.begin(), nodes.end());
+
+    for(KinoNodePtr ptr : nodes){
+        TrajectoryState piece;
+        piece.setPrimitive(ptr->cameFrom->position, ptr->cameFrom->velocity, ptr->input, ptr->duration);
+        piece.Trajctory_Cost  = ptr->gScore;
+        piece.collision_check = false;
+        piece.optimal_flag    = false;
+        trajectory.push_back(piece);
+    }
+    trajectory.push_back(TrajectoryState(shot_coeff, shot_T, cost));
+    return trajectory;
+}
@@ -0,0 +1,338 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <math.h>
+#include <Eigen/Eigen>
+#include <unsupported/Eigen/Polynomials>
+
+#include <obvp_solver.h>
+
+using namespace std;
+using namespace Eigen;
+
+/*
+    Micro-benchmark and accuracy check of obvp::solve against the companion matrix solve of the same
+    stationary condition with Eigen::PolynomialSolver, which Homeworktool::OptimalBVP used before, and of
+    obvp::solveBatch against obvp::solve on primitive sets sharing one target. The general obvp::solve is
+    checked per variant for its boundary conditions and against a scan of J(T), and timed.
+
+    rosrun grid_path_searcher obvp_benchmark [case_num] [seed] [batch_size]
+
+    Exits with 1 if any case disagrees beyond the tolerance.
+*/
+
+struct Case
+{
+    Vector3d p_0, v_0, p_f, v_f;
+};
+
+// reference: T^2 (T^4 - 4a T^2 + 24b T - 36c) as a degree 6 polynomial, positive real roots, least cost
+static bool solveReference(const Case &cs, double &T_opt, double &cost_opt)
+{
+    Vector3d dp = cs.p_f - cs.p_0;
+    double a = cs.v_0.squaredNorm() + cs.v_0.dot(cs.v_f) + cs.v_f.squaredNorm();
+    double b = dp.dot(cs.v_0 + cs.v_f);
+    double c = dp.squaredNorm();
+
+    Eigen::VectorXd coeff(7);
+    coeff << 0.0, 0.0, -36.0 * c, 24.0 * b, -4.0 * a, 0.0, 1.0;
+    Eigen::PolynomialSolver<double, Eigen::Dynamic> solver;
+    solver.compute(coeff);
+    const Eigen::PolynomialSolver<double, Eigen::Dynamic>::RootsType &rt = solver.roots();
+
+    T_opt = -1.0;
+    cost_opt = INFINITY;
+    for (int i = 0; i < rt.rows(); ++i)
+    {
+        if (rt(i).real() > 1e-6 && std::abs(rt(i).imag()) < 1e-6)
+        {
+            double J = obvp::cost(a, b, c, rt(i).real());
+            if (J < cost_opt)
+            {
+                T_opt = rt(i).real();
+                cost_opt = J;
+            }
+        }
+    }
+    return T_opt > 0.0;
+}
+
+static vector<Case> makeCases(int case_num, unsigned seed)
+{
+    mt19937 gen(seed);
+    uniform_real_distribution<double> pos(-10.0, 10.0), vel(-3.0, 3.0), unit(0.0, 1.0);
+    vector<Case> cases;
+    // degenerate boundary values first
+    Case cs;
+    cs.p_0 = cs.p_f = Vector3d(1.0, 2.0, 3.0);
+    cs.v_0 = cs.v_f = Vector3d::Zero();
+    cases.push_back(cs);
+    cs.v_0 = Vector3d(1.0, -0.5, 0.0);
+    cases.push_back(cs);
+    cs.p_f = cs.p_0 + Vector3d(1e-4, 0.0, 0.0);
+    cases.push_back(cs);
+    cs.v_0 = Vector3d::Zero();
+    cases.push_back(cs);
+    cs.p_f = cs.p_0 + Vector3d(0.0, 5.0, 0.0);
+    cs.v_0 = Vector3d(0.0, -2.0, 0.0);
+    cases.push_back(cs);
+
+    while ((int)cases.size() < case_num)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            cs.p_0(i) = pos(gen);
+            cs.p_f(i) = pos(gen);
+            cs.v_0(i) = vel(gen);
+            cs.v_f(i) = vel(gen);
+        }
+        // like the lattice primitives, most of the ends are at rest and close by
+        if (unit(gen) < 0.5)
+            cs.v_f.setZero();
+        if (unit(gen) < 0.3)
+            cs.p_f = cs.p_0 + 0.1 * (cs.p_f - cs.p_0);
+        cases.push_back(cs);
+    }
+    return cases;
+}
+
+struct Variant
+{
+    const char *name;
+    int order;
+    bool fix_v_f, fix_a_f;
+};
+
+// worst boundary residual at T over the fixed end values and the vanishing costates of the free ones
+static double boundaryError(const obvp::Problem &pb, const obvp::PolySolution &sol)
+{
+    double T = sol.T;
+    Vector3d p = Vector3d::Zero(), v = Vector3d::Zero(), a = Vector3d::Zero(), j = Vector3d::Zero(), s = Vector3d::Zero();
+    for (int k = 0; k < 6; ++k)
+    {
+        int e = 5 - k;
+        Vector3d c = sol.coeff.row(k).transpose();
+        p += c * pow(T, e);
+        if (e >= 1) v += e * c * pow(T, e - 1);
+        if (e >= 2) a += e * (e - 1) * c * pow(T, e - 2);
+        if (e >= 3) j += e * (e - 1) * (e - 2) * c * pow(T, e - 3);
+        if (e >= 4) s += e * (e - 1) * (e - 2) * (e - 3) * c * pow(T, e - 4);
+    }
+    double err = (p - pb.p_f).norm() / (1.0 + pb.p_f.norm());
+    if (pb.fix_v_f)
+        err = max(err, (v - pb.v_f).norm() / (1.0 + pb.v_f.norm()));
+    if (pb.order == 2)
+    {
+        if (!pb.fix_v_f)
+            err = max(err, a.norm() / (1.0 + a.norm() + j.norm() * T));
+        return err;
+    }
+    if (pb.fix_a_f)
+        err = max(err, (a - pb.a_f).norm() / (1.0 + pb.a_f.norm()));
+    else
+        err = max(err, j.norm() / (1.0 + j.norm() + s.norm() * T));
+    if (!pb.fix_v_f)
+        err = max(err, s.norm() / (1.0 + s.norm() + (j.norm() + s.norm()) / T));
+    return err;
+}
+
+// accuracy and latency of every variant of the general problem, false if a check fails
+static bool benchmarkVariants(const vector<Case> &cases, unsigned seed, double tol)
+{
+    const Variant variants[] = {{"double, fixed v", 2, true, false}, {"double, free v", 2, false, false},
+                                {"triple, fixed v a", 3, true, true}, {"triple, fixed v free a", 3, true, false},
+                                {"triple, free v fixed a", 3, false, true}, {"triple, free v a", 3, false, false}};
+    mt19937 gen(seed + 1);
+    uniform_real_distribution<double> acc(-2.0, 2.0), log_rho(-2.0, 2.0);
+    vector<obvp::Problem> problems(cases.size());
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        obvp::Problem &pb = problems[i];
+        pb.p_0 = cases[i].p_0, pb.v_0 = cases[i].v_0, pb.p_f = cases[i].p_f, pb.v_f = cases[i].v_f;
+        pb.a_0 = Vector3d(acc(gen), acc(gen), acc(gen));
+        pb.a_f = i % 2 ? Vector3d::Zero() : Vector3d(acc(gen), acc(gen), acc(gen));
+        pb.rho = i % 3 ? pow(10.0, log_rho(gen)) : 1.0;
+    }
+    // the first cases are the degenerate ones, keep them degenerate for the triple integrator too
+    for (size_t i = 0; i < min<size_t>(5, cases.size()); ++i)
+        problems[i].a_0 = problems[i].a_f = Vector3d::Zero();
+
+    bool pass = true;
+    for (const Variant &variant : variants)
+    {
+        double max_boundary_err = 0.0, max_scan_err = 0.0, max_fast_err = 0.0;
+        int solved_num = 0;
+        for (size_t i = 0; i < problems.size(); ++i)
+        {
+            obvp::Problem pb = problems[i];
+            pb.order = variant.order, pb.fix_v_f = variant.fix_v_f, pb.fix_a_f = variant.fix_a_f;
+            obvp::PolySolution sol;
+            if (!obvp::solve(pb, sol))
+                continue;
+            ++solved_num;
+            max_boundary_err = max(max_boundary_err, boundaryError(pb, sol));
+            // no duration on a log scan around T may be cheaper, the scan is the expensive part so only on some
+            if (i % 50 == 0)
+            {
+                obvp::PolySolution other;
+                for (int k = -400; k <= 400; ++k)
+                {
+                    double J = obvp::evaluate(pb, sol.T * pow(10.0, k / 100.0), other);
+                    max_scan_err = max(max_scan_err, (sol.cost - J) / sol.cost);
+                }
+            }
+            if (variant.order == 2 && variant.fix_v_f && pb.rho == 1.0)
+            {
+                obvp::Solution fast;
+                if (obvp::solve(pb.p_0, pb.v_0, pb.p_f, pb.v_f, fast))
+                    max_fast_err = max(max_fast_err, fabs(fast.cost - sol.cost) / sol.cost);
+            }
+        }
+
+        double sink = 0.0;
+        auto t0 = chrono::steady_clock::now();
+        for (obvp::Problem pb : problems)
+        {
+            pb.order = variant.order, pb.fix_v_f = variant.fix_v_f, pb.fix_a_f = variant.fix_a_f;
+            obvp::PolySolution sol;
+            if (obvp::solve(pb, sol))
+                sink += sol.cost;
+        }
+        auto t1 = chrono::steady_clock::now();
+        double ns = chrono::duration<double, nano>(t1 - t0).count() / problems.size();
+
+        bool ok = max_boundary_err < tol && max_scan_err < tol && max_fast_err < tol;
+        pass = pass && ok;
+        cout << "[obvp_benchmark] " << variant.name << ": " << solved_num << " solved, max error boundary " << max_boundary_err
+             << ", vs scan " << max_scan_err << ", vs fixed v solve " << max_fast_err << ", " << ns << " ns/solve"
+             << (ok ? "  PASS" : "  FAIL") << " (checksum " << sink << ")" << endl;
+    }
+    return pass;
+}
+
+int main(int argc, char **argv)
+{
+    int case_num = argc > 1 ? atoi(argv[1]) : 200000;
+    unsigned seed = argc > 2 ? atoi(argv[2]) : 1;
+    int batch_size = argc > 3 ? atoi(argv[3]) : 125;
+    vector<Case> cases = makeCases(case_num, seed);
+
+    // accuracy
+    int mismatch_num = 0, solved_num = 0;
+    double max_T_err = 0.0, max_cost_err = 0.0, max_boundary_err = 0.0;
+    for (const auto &cs : cases)
+    {
+        double T_ref, cost_ref;
+        bool ref_ok = solveReference(cs, T_ref, cost_ref);
+        obvp::Solution sol;
+        bool ok = obvp::solve(cs.p_0, cs.v_0, cs.p_f, cs.v_f, sol);
+        if (ok != ref_ok)
+        {
+            ++mismatch_num;
+            continue;
+        }
+        if (!ok)
+            continue;
+        ++solved_num;
+        max_T_err = max(max_T_err, fabs(sol.T - T_ref) / T_ref);
+        max_cost_err = max(max_cost_err, fabs(sol.cost - cost_ref) / cost_ref);
+
+        double T = sol.T;
+        Vector3d p_T = ((sol.coeff.row(0) * T + sol.coeff.row(1)) * T + sol.coeff.row(2)).transpose() * T + sol.coeff.row(3).transpose();
+        Vector3d v_T = ((3.0 * sol.coeff.row(0) * T + 2.0 * sol.coeff.row(1)) * T + sol.coeff.row(2)).transpose();
+        double scale = 1.0 + cs.p_f.norm() + cs.v_f.norm();
+        max_boundary_err = max(max_boundary_err, ((p_T - cs.p_f).norm() + (v_T - cs.v_f).norm()) / scale);
+    }
+    const double tol = 1e-8;
+    bool pass = mismatch_num == 0 && max_T_err < tol && max_cost_err < tol && max_boundary_err < tol;
+    cout << "[obvp_benchmark] " << cases.size() << " cases, " << solved_num << " solved, " << mismatch_num << " disagree on solvability" << endl;
+    cout << "[obvp_benchmark] max relative error T: " << max_T_err << ", cost: " << max_cost_err
+         << ", boundary: " << max_boundary_err << (pass ? "  PASS" : "  FAIL") << endl;
+
+    // speed
+    double sink = 0.0;
+    auto t0 = chrono::steady_clock::now();
+    for (const auto &cs : cases)
+    {
+        double T, J;
+        if (solveReference(cs, T, J))
+            sink += J;
+    }
+    auto t1 = chrono::steady_clock::now();
+    for (const auto &cs : cases)
+    {
+        obvp::Solution sol;
+        if (obvp::solve(cs.p_0, cs.v_0, cs.p_f, cs.v_f, sol))
+            sink += sol.cost;
+    }
+    auto t2 = chrono::steady_clock::now();
+    double ref_ns = chrono::duration<double, nano>(t1 - t0).count() / cases.size();
+    double new_ns = chrono::duration<double, nano>(t2 - t1).count() / cases.size();
+    cout << "[obvp_benchmark] PolynomialSolver: " << ref_ns << " ns/solve, closed form: " << new_ns
+         << " ns/solve, speedup " << ref_ns / new_ns << " (checksum " << sink << ")" << endl;
+
+    // batches: the start states of the cases towards the target of the first case of each batch
+    int batch_num = cases.size() / batch_size;
+    vector<double> p_x(cases.size()), p_y(cases.size()), p_z(cases.size()), v_x(cases.size()), v_y(cases.size()), v_z(cases.size());
+    vector<double> T_batch(cases.size()), cost_batch(cases.size());
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        p_x[i] = cases[i].p_0(0), p_y[i] = cases[i].p_0(1), p_z[i] = cases[i].p_0(2);
+        v_x[i] = cases[i].v_0(0), v_y[i] = cases[i].v_0(1), v_z[i] = cases[i].v_0(2);
+    }
+    auto solveBatches = [&]()
+    {
+        for (int k = 0; k < batch_num; ++k)
+        {
+            int o = k * batch_size;
+            obvp::solveBatch(batch_size, &p_x[o], &p_y[o], &p_z[o], &v_x[o], &v_y[o], &v_z[o],
+                             cases[o].p_f, cases[o].v_f, &T_batch[o], &cost_batch[o]);
+        }
+    };
+    solveBatches();
+    int batch_mismatch_num = 0;
+    double max_batch_err = 0.0;
+    for (int k = 0; k < batch_num; ++k)
+    {
+        int o = k * batch_size;
+        for (int i = o; i < o + batch_size; ++i)
+        {
+            obvp::Solution sol;
+            bool ok = obvp::solve(cases[i].p_0, cases[i].v_0, cases[o].p_f, cases[o].v_f, sol);
+            if (ok != (T_batch[i] > 0.0))
+                ++batch_mismatch_num;
+            else if (ok)
+                max_batch_err = max(max_batch_err, max(fabs(T_batch[i] - sol.T) / sol.T, fabs(cost_batch[i] - sol.cost) / sol.cost));
+        }
+    }
+    bool batch_pass = batch_mismatch_num == 0 && max_batch_err < tol;
+    cout << "[obvp_benchmark] batch of " << batch_size << ": " << batch_mismatch_num << " disagree on solvability, max relative error "
+         << max_batch_err << (batch_pass ? "  PASS" : "  FAIL") << endl;
+
+    auto t3 = chrono::steady_clock::now();
+    for (int k = 0; k < batch_num; ++k)
+    {
+        int o = k * batch_size;
+        for (int i = o; i < o + batch_size; ++i)
+        {
+            obvp::Solution sol;
+            if (obvp::solve(cases[i].p_0, cases[i].v_0, cases[o].p_f, cases[o].v_f, sol))
+                sink += sol.cost;
+        }
+    }
+    auto t4 = chrono::steady_clock::now();
+    solveBatches();
+    auto t5 = chrono::steady_clock::now();
+    double one_by_one_us = chrono::duration<double, micro>(t4 - t3).count() / batch_num;
+    double batch_us = chrono::duration<double, micro>(t5 - t4).count() / batch_num;
+    for (size_t i = 0; i < cases.size(); ++i)
+        if (T_batch[i] > 0.0)
+            sink += cost_batch[i];
+    cout << "[obvp_benchmark] batch of " << batch_size << ": one by one " << one_by_one_us << " us, solveBatch " << batch_us
+         << " us, speedup " << one_by_one_us / batch_us << " (checksum " << sink << ")" << endl;
+
+    bool variant_pass = benchmarkVariants(cases, seed, tol);
+
+    return pass && batch_pass && variant_pass ? 0 : 1;
+}
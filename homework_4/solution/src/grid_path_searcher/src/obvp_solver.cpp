@@ -0,0 +1,528 @@
+#include <obvp_solver.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OBVP_AVX2_KERNEL
+#endif
+
+using namespace std;
+using namespace Eigen;
+
+namespace obvp
+{
+
+// real roots of x^2 + b x + c, the form without cancellation
+static int solveQuadratic(double b, double c, double roots[2])
+{
+    double disc = b * b - 4.0 * c;
+    if (disc < 0.0)
+        return 0;
+    double s = -0.5 * (b + (b >= 0.0 ? sqrt(disc) : -sqrt(disc)));
+    if (s == 0.0)
+    {
+        roots[0] = roots[1] = 0.0;
+        return 2;
+    }
+    roots[0] = s;
+    roots[1] = c / s;
+    return 2;
+}
+
+int solveCubic(double a2, double a1, double a0, double roots[3])
+{
+    double Q = (a2 * a2 - 3.0 * a1) / 9.0;
+    double R = (2.0 * a2 * a2 * a2 - 9.0 * a2 * a1 + 27.0 * a0) / 54.0;
+    double Q3 = Q * Q * Q;
+    if (R * R < Q3)
+    {
+        double theta = acos(R / sqrt(Q3));
+        double sq = -2.0 * sqrt(Q);
+        roots[0] = sq * cos(theta / 3.0) - a2 / 3.0;
+        roots[1] = sq * cos((theta + 2.0 * M_PI) / 3.0) - a2 / 3.0;
+        roots[2] = sq * cos((theta - 2.0 * M_PI) / 3.0) - a2 / 3.0;
+        return 3;
+    }
+    double A = -copysign(cbrt(fabs(R) + sqrt(R * R - Q3)), R);
+    double B = A == 0.0 ? 0.0 : Q / A;
+    roots[0] = A + B - a2 / 3.0;
+    return 1;
+}
+
+int solveDepressedQuartic(double p, double q, double r, double roots[4])
+{
+    // largest root m of the resolvent cubic 8m^3 + 8p m^2 + (2p^2 - 8r) m - q^2, it splits the quartic into
+    // (x^2 - s x + p/2 + m + q/2s)(x^2 + s x + p/2 + m - q/2s) with s = sqrt(2m)
+    double cubic_roots[3];
+    int cubic_num = solveCubic(p, 0.25 * p * p - r, -0.125 * q * q, cubic_roots);
+    double m = *std::max_element(cubic_roots, cubic_roots + cubic_num);
+    // one Newton step against the cancellation in the trigonometric / Cardano form
+    double f = ((m + p) * m + 0.25 * p * p - r) * m - 0.125 * q * q;
+    double df = (3.0 * m + 2.0 * p) * m + 0.25 * p * p - r;
+    if (df != 0.0)
+        m -= f / df;
+
+    int num = 0;
+    if (m <= 1e-12 * (1.0 + fabs(p)))
+    {
+        // q vanishes, biquadratic in x^2
+        double y[2];
+        if (solveQuadratic(p, r, y) == 0)
+            return 0;
+        for (int i = 0; i < 2; ++i)
+            if (y[i] >= 0.0)
+            {
+                roots[num++] = sqrt(y[i]);
+                roots[num++] = -sqrt(y[i]);
+            }
+        return num;
+    }
+    double s = sqrt(2.0 * m);
+    double h = 0.5 * p + m, g = 0.5 * q / s;
+    num += solveQuadratic(-s, h + g, roots);
+    num += solveQuadratic(s, h - g, roots + num);
+    return num;
+}
+
+double cost(double a, double b, double c, double T)
+{
+    double T_inv = 1.0 / T;
+    return T + ((12.0 * c * T_inv - 12.0 * b) * T_inv + 4.0 * a) * T_inv;
+}
+
+// least cost positive stationary T of J(T) = T + 4a / T - 12b / T^2 + 12c / T^3, T = -1 if there is none
+static void solveStationary(double a, double b, double c, double &T_opt, double &cost_opt)
+{
+    double p = -4.0 * a, q = 24.0 * b, r = -36.0 * c;
+    double roots[4];
+    int num = solveDepressedQuartic(p, q, r, roots);
+    T_opt = -1.0;
+    cost_opt = INFINITY;
+    for (int i = 0; i < num; ++i)
+    {
+        double T = roots[i];
+        if (T <= 1e-6)
+            continue;
+        // polish on the quartic itself, the closed form loses digits on nearly double roots
+        for (int k = 0; k < 2; ++k)
+        {
+            double f = ((T * T + p) * T + q) * T + r;
+            double df = (4.0 * T * T + 2.0 * p) * T + q;
+            if (df == 0.0)
+                break;
+            T -= f / df;
+        }
+        if (T <= 1e-6)
+            continue;
+        double J = cost(a, b, c, T);
+        if (J < cost_opt)
+        {
+            T_opt = T;
+            cost_opt = J;
+        }
+    }
+}
+
+bool solve(const Vector3d &p_0, const Vector3d &v_0, const Vector3d &p_f, const Vector3d &v_f, Solution &sol)
+{
+    Vector3d dp = p_f - p_0;
+    double a = v_0.squaredNorm() + v_0.dot(v_f) + v_f.squaredNorm();
+    double b = dp.dot(v_0 + v_f);
+    double c = dp.squaredNorm();
+    solveStationary(a, b, c, sol.T, sol.cost);
+    if (sol.T < 0.0)
+        return false;
+
+    // acceleration alpha t + beta per axis
+    double T = sol.T, T_inv = 1.0 / T;
+    Vector3d delta_p = dp - v_0 * T, delta_v = v_f - v_0;
+    Vector3d alpha = (-12.0 * delta_p * T_inv + 6.0 * delta_v) * T_inv * T_inv;
+    Vector3d beta = (6.0 * delta_p * T_inv - 2.0 * delta_v) * T_inv;
+    sol.coeff.row(0) = alpha.transpose() / 6.0;
+    sol.coeff.row(1) = beta.transpose() / 2.0;
+    sol.coeff.row(2) = v_0.transpose();
+    sol.coeff.row(3) = p_0.transpose();
+    return true;
+}
+
+// Roots of sum_k poly[k] x^k, poly[degree] != 0, where it changes sign in (lo, hi), ascending. Between two
+// neighbouring roots of the derivative the polynomial is monotone, so each of these intervals holds at most
+// one of them, found by Newton safeguarded by bisection.
+static int solveRealRoots(const double *poly, int degree, double lo, double hi, double *roots)
+{
+    if (degree == 1)
+    {
+        double x = -poly[0] / poly[1];
+        if (x > lo && x < hi)
+        {
+            roots[0] = x;
+            return 1;
+        }
+        return 0;
+    }
+    double deriv[6], ends[7];
+    for (int k = 1; k <= degree; ++k)
+        deriv[k - 1] = k * poly[k];
+    ends[0] = lo;
+    int end_num = 1 + solveRealRoots(deriv, degree - 1, lo, hi, ends + 1);
+    ends[end_num++] = hi;
+
+    auto eval = [&](double x)
+    {
+        double f = poly[degree];
+        for (int k = degree - 1; k >= 0; --k)
+            f = f * x + poly[k];
+        return f;
+    };
+    int num = 0;
+    double f_a = eval(ends[0]);
+    for (int i = 0; i + 1 < end_num; ++i)
+    {
+        double a = ends[i], b = ends[i + 1], f_b = eval(b);
+        if ((f_a < 0.0) == (f_b < 0.0) || f_a == 0.0)
+        {
+            f_a = f_b;
+            continue;
+        }
+        double sign_a = f_a < 0.0 ? -1.0 : 1.0;
+        double x = 0.5 * (a + b);
+        for (int k = 0; k < 100; ++k)
+        {
+            double f = poly[degree], df = 0.0;
+            for (int j = degree - 1; j >= 0; --j)
+            {
+                df = df * x + f;
+                f = f * x + poly[j];
+            }
+            if (f == 0.0)
+                break;
+            if ((f < 0.0) == (sign_a < 0.0))
+                a = x;
+            else
+                b = x;
+            double next = df != 0.0 ? x - f / df : a;
+            if (!(next > a && next < b))
+                next = 0.5 * (a + b);
+            if (fabs(next - x) <= 1e-12 * fabs(x) || b - a <= 1e-12 * fabs(x))
+            {
+                x = next;
+                break;
+            }
+            x = next;
+        }
+        roots[num++] = x;
+        f_a = f_b;
+    }
+    return num;
+}
+
+// Input u(t) = alpha t + beta (double integrator) or alpha t^2 / 2 + beta t + gamma (triple integrator) per
+// axis. A free final velocity makes the costate of the velocity vanish at T, i.e. a(T) = 0 for the double
+// and u'(T) = 0 for the triple integrator, a free final acceleration makes u(T) = 0
+double evaluate(const Problem &pb, double T, PolySolution &sol)
+{
+    Vector3d dp = pb.p_f - pb.p_0;
+    const Vector3d &v_0 = pb.v_0, &v_f = pb.v_f, &a_0 = pb.a_0, &a_f = pb.a_f;
+    double T2 = T * T, T3 = T2 * T, T4 = T3 * T, T5 = T4 * T;
+    Vector3d alpha, beta, gamma;
+    sol.T = T;
+    sol.coeff.setZero();
+    if (pb.order == 2)
+    {
+        if (pb.fix_v_f)
+        {
+            alpha = 6.0 * (T * (v_0 + v_f) - 2.0 * dp) / T3;
+            beta = -2.0 * (T * (2.0 * v_0 + v_f) - 3.0 * dp) / T2;
+        }
+        else
+        {
+            alpha = 3.0 * (T * v_0 - dp) / T3;
+            beta = -alpha * T;
+        }
+        sol.coeff.row(2) = alpha.transpose() / 6.0;
+        sol.coeff.row(3) = beta.transpose() / 2.0;
+        sol.coeff.row(4) = v_0.transpose();
+        sol.coeff.row(5) = pb.p_0.transpose();
+        sol.cost = pb.rho * T + alpha.squaredNorm() * T3 / 3.0 + alpha.dot(beta) * T2 + beta.squaredNorm() * T;
+        return sol.cost;
+    }
+
+    if (pb.fix_v_f && pb.fix_a_f)
+    {
+        alpha = -60.0 * (T2 * (a_0 - a_f) + 6.0 * T * (v_0 + v_f) - 12.0 * dp) / T5;
+        beta = 12.0 * (T2 * (3.0 * a_0 - 2.0 * a_f) + T * (16.0 * v_0 + 14.0 * v_f) - 30.0 * dp) / T4;
+        gamma = -3.0 * (T2 * (3.0 * a_0 - a_f) + T * (12.0 * v_0 + 8.0 * v_f) - 20.0 * dp) / T3;
+    }
+    else if (pb.fix_v_f)
+    {
+        alpha = -40.0 * (T2 * a_0 + T * (5.0 * v_0 + 3.0 * v_f) - 8.0 * dp) / T5;
+        beta = 4.0 * (7.0 * T2 * a_0 + T * (32.0 * v_0 + 18.0 * v_f) - 50.0 * dp) / T4;
+        gamma = -4.0 * (2.0 * T2 * a_0 + T * (7.0 * v_0 + 3.0 * v_f) - 10.0 * dp) / T3;
+    }
+    else if (pb.fix_a_f)
+    {
+        Vector3d delta = T2 * (2.0 * a_0 + a_f) + 6.0 * T * v_0 - 6.0 * dp;
+        alpha = -7.5 * delta / T5;
+        beta = 7.5 * delta / T4;
+        gamma = -1.5 * (T2 * (4.0 * a_0 + a_f) + 10.0 * (T * v_0 - dp)) / T3;
+    }
+    else
+    {
+        Vector3d delta = T2 * a_0 + 2.0 * (T * v_0 - dp);
+        alpha = -10.0 * delta / T5;
+        beta = 10.0 * delta / T4;
+        gamma = -5.0 * delta / T3;
+    }
+    sol.coeff.row(0) = alpha.transpose() / 120.0;
+    sol.coeff.row(1) = beta.transpose() / 24.0;
+    sol.coeff.row(2) = gamma.transpose() / 6.0;
+    sol.coeff.row(3) = a_0.transpose() / 2.0;
+    sol.coeff.row(4) = v_0.transpose();
+    sol.coeff.row(5) = pb.p_0.transpose();
+    sol.cost = pb.rho * T + alpha.squaredNorm() * T5 / 20.0 + alpha.dot(beta) * T4 / 4.0 +
+               (beta.squaredNorm() + alpha.dot(gamma)) * T3 / 3.0 + beta.dot(gamma) * T2 + gamma.squaredNorm() * T;
+    return sol.cost;
+}
+
+bool solve(const Problem &pb, PolySolution &sol)
+{
+    Vector3d dp = pb.p_f - pb.p_0;
+    const Vector3d &v_0 = pb.v_0, &v_f = pb.v_f, &a_0 = pb.a_0, &a_f = pb.a_f;
+
+    // rho T^n + c[n - 2] T^(n - 2) + ... + c[0] = 0 is T^(n + 1) dJ/dT = 0, n = 2 order
+    double c[5] = {0.0, 0.0, 0.0, 0.0, 0.0}, lead = pb.rho;
+    if (pb.order == 2 && pb.fix_v_f)
+    {
+        c[2] = -4.0 * (v_0.squaredNorm() + v_0.dot(v_f) + v_f.squaredNorm());
+        c[1] = 24.0 * dp.dot(v_0 + v_f);
+        c[0] = -36.0 * dp.squaredNorm();
+    }
+    else if (pb.order == 2)
+    {
+        c[2] = -3.0 * v_0.squaredNorm();
+        c[1] = 12.0 * dp.dot(v_0);
+        c[0] = -9.0 * dp.squaredNorm();
+    }
+    else if (pb.fix_v_f && pb.fix_a_f)
+    {
+        c[4] = -9.0 * a_0.squaredNorm() + 6.0 * a_0.dot(a_f) - 9.0 * a_f.squaredNorm();
+        c[3] = -144.0 * v_0.dot(a_0) + 96.0 * v_0.dot(a_f) - 96.0 * a_0.dot(v_f) + 144.0 * v_f.dot(a_f);
+        c[2] = 360.0 * dp.dot(a_0 - a_f) - 576.0 * v_0.squaredNorm() - 1008.0 * v_0.dot(v_f) - 576.0 * v_f.squaredNorm();
+        c[1] = 2880.0 * dp.dot(v_0 + v_f);
+        c[0] = -3600.0 * dp.squaredNorm();
+    }
+    else if (pb.fix_v_f)
+    {
+        c[4] = -8.0 * a_0.squaredNorm();
+        c[3] = -112.0 * v_0.dot(a_0) - 48.0 * a_0.dot(v_f);
+        c[2] = 240.0 * dp.dot(a_0) - 384.0 * v_0.squaredNorm() - 432.0 * v_0.dot(v_f) - 144.0 * v_f.squaredNorm();
+        c[1] = 1600.0 * dp.dot(v_0) + 960.0 * dp.dot(v_f);
+        c[0] = -1600.0 * dp.squaredNorm();
+    }
+    else if (pb.fix_a_f)
+    {
+        lead = 4.0 * pb.rho;
+        c[4] = -24.0 * a_0.squaredNorm() - 12.0 * a_0.dot(a_f) - 9.0 * a_f.squaredNorm();
+        c[3] = -240.0 * v_0.dot(a_0) - 120.0 * v_0.dot(a_f);
+        c[2] = 360.0 * dp.dot(a_0) + 180.0 * dp.dot(a_f) - 540.0 * v_0.squaredNorm();
+        c[1] = 1440.0 * dp.dot(v_0);
+        c[0] = -900.0 * dp.squaredNorm();
+    }
+    else
+    {
+        c[4] = -5.0 * a_0.squaredNorm();
+        c[3] = -40.0 * v_0.dot(a_0);
+        c[2] = 60.0 * dp.dot(a_0) - 60.0 * v_0.squaredNorm();
+        c[1] = 160.0 * dp.dot(v_0);
+        c[0] = -100.0 * dp.squaredNorm();
+    }
+
+    int degree = 2 * pb.order;
+    double roots[6];
+    int num = 0;
+    if (pb.order == 2)
+    {
+        num = solveDepressedQuartic(c[2] / lead, c[1] / lead, c[0] / lead, roots);
+    }
+    else
+    {
+        // roots are below the Fujiwara bound, which unlike the Cauchy bound scales like T
+        double poly[7] = {c[0] / lead, c[1] / lead, c[2] / lead, c[3] / lead, c[4] / lead, 0.0, 1.0};
+        double bound = pow(0.5 * fabs(poly[0]), 1.0 / 6.0);
+        for (int k = 1; k < 5; ++k)
+            bound = max(bound, pow(fabs(poly[k]), 1.0 / (6 - k)));
+        num = solveRealRoots(poly, 6, 0.0, 2.0 * bound, roots);
+    }
+
+    sol.T = -1.0;
+    sol.cost = INFINITY;
+    double T_opt = -1.0;
+    for (int i = 0; i < num; ++i)
+    {
+        double T = roots[i];
+        if (T <= 1e-6)
+            continue;
+        // polish, the quartic closed form loses digits on nearly double roots
+        for (int k = 0; k < 2; ++k)
+        {
+            double f = lead, df = 0.0;
+            for (int j = degree - 1; j >= 0; --j)
+            {
+                df = df * T + f;
+                f = f * T + (j < 5 ? c[j] : 0.0);
+            }
+            if (df == 0.0)
+                break;
+            T -= f / df;
+        }
+        if (T <= 1e-6)
+            continue;
+        PolySolution candidate;
+        if (evaluate(pb, T, candidate) < sol.cost)
+        {
+            sol = candidate;
+            T_opt = T;
+        }
+    }
+    return T_opt > 0.0;
+}
+
+static void solveBatchScalar(int begin, int end, const double *p_x, const double *p_y, const double *p_z,
+                             const double *v_x, const double *v_y, const double *v_z,
+                             const Vector3d &p_f, const Vector3d &v_f, double *T, double *cost)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        Vector3d dp = p_f - Vector3d(p_x[i], p_y[i], p_z[i]), v_0(v_x[i], v_y[i], v_z[i]);
+        double a = v_0.squaredNorm() + v_0.dot(v_f) + v_f.squaredNorm();
+        double b = dp.dot(v_0 + v_f);
+        double c = dp.squaredNorm();
+        solveStationary(a, b, c, T[i], cost[i]);
+    }
+}
+
+#ifdef OBVP_AVX2_KERNEL
+// Same roots as solveStationary four lanes at a time. The resolvent cubic g(m) has g(0) = -q^2/8 <= 0, so
+// [0, m_up] brackets a root and Newton falls back to bisection whenever it leaves the bracket. Ferrari
+// works with any positive root, not only the largest one. Lanes that do not converge or whose root is
+// zero (q = 0, the biquadratic case) are redone by the scalar solver. Returns the number of states done.
+__attribute__((target("avx2,fma"))) static int solveBatchAVX2(int n, const double *p_x, const double *p_y, const double *p_z,
+                                                               const double *v_x, const double *v_y, const double *v_z,
+                                                               const Vector3d &p_f, const Vector3d &v_f, double *T, double *cost)
+{
+    const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0), half = _mm256_set1_pd(0.5);
+    const __m256d sign_mask = _mm256_set1_pd(-0.0), T_min = _mm256_set1_pd(1e-6);
+    const __m256d pfx = _mm256_set1_pd(p_f(0)), pfy = _mm256_set1_pd(p_f(1)), pfz = _mm256_set1_pd(p_f(2));
+    const __m256d vfx = _mm256_set1_pd(v_f(0)), vfy = _mm256_set1_pd(v_f(1)), vfz = _mm256_set1_pd(v_f(2));
+    const __m256d vf_sq = _mm256_set1_pd(v_f.squaredNorm());
+    const int max_iterations = 24;
+
+    int n4 = n & ~3;
+    for (int i = 0; i < n4; i += 4)
+    {
+        __m256d vx = _mm256_loadu_pd(v_x + i), vy = _mm256_loadu_pd(v_y + i), vz = _mm256_loadu_pd(v_z + i);
+        __m256d dpx = _mm256_sub_pd(pfx, _mm256_loadu_pd(p_x + i));
+        __m256d dpy = _mm256_sub_pd(pfy, _mm256_loadu_pd(p_y + i));
+        __m256d dpz = _mm256_sub_pd(pfz, _mm256_loadu_pd(p_z + i));
+        __m256d wx = _mm256_add_pd(vx, vfx), wy = _mm256_add_pd(vy, vfy), wz = _mm256_add_pd(vz, vfz);
+        // a = |v_0|^2 + v_0.v_f + |v_f|^2 = v_0.(v_0 + v_f) + |v_f|^2
+        __m256d a = _mm256_fmadd_pd(vx, wx, _mm256_fmadd_pd(vy, wy, _mm256_fmadd_pd(vz, wz, vf_sq)));
+        __m256d b = _mm256_fmadd_pd(dpx, wx, _mm256_fmadd_pd(dpy, wy, _mm256_mul_pd(dpz, wz)));
+        __m256d c = _mm256_fmadd_pd(dpx, dpx, _mm256_fmadd_pd(dpy, dpy, _mm256_mul_pd(dpz, dpz)));
+        __m256d p = _mm256_mul_pd(_mm256_set1_pd(-4.0), a);
+        __m256d q = _mm256_mul_pd(_mm256_set1_pd(24.0), b);
+        __m256d r = _mm256_mul_pd(_mm256_set1_pd(-36.0), c);
+
+        // resolvent m^3 + A2 m^2 + A1 m + A0 with A2 = p <= 0, A1 = p^2/4 - r >= 0, A0 = -q^2/8 <= 0, positive
+        // at m_up = max(2|A2|, 1, sqrt(2|A0|)) as m^3 + A2 m^2 >= m^3 / 2 >= |A0| there
+        __m256d A2 = p;
+        __m256d A1 = _mm256_fmsub_pd(_mm256_mul_pd(_mm256_set1_pd(0.25), p), p, r);
+        __m256d A0 = _mm256_mul_pd(_mm256_set1_pd(-0.125), _mm256_mul_pd(q, q));
+        __m256d abs_A2 = _mm256_andnot_pd(sign_mask, A2), abs_A0 = _mm256_andnot_pd(sign_mask, A0);
+        __m256d lo = zero;
+        __m256d hi = _mm256_max_pd(_mm256_max_pd(_mm256_add_pd(abs_A2, abs_A2), one), _mm256_sqrt_pd(_mm256_add_pd(abs_A0, abs_A0)));
+        // first Newton step from 0, min picks hi when it is 0 / 0
+        __m256d m = _mm256_min_pd(_mm256_div_pd(abs_A0, A1), hi);
+        __m256d done = zero;
+        for (int k = 0; k < max_iterations; ++k)
+        {
+            __m256d g = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_add_pd(m, A2), m, A1), m, A0);
+            __m256d scale = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_add_pd(m, abs_A2), m, A1), m, abs_A0);
+            done = _mm256_or_pd(done, _mm256_cmp_pd(_mm256_andnot_pd(sign_mask, g), _mm256_mul_pd(_mm256_set1_pd(1e-13), scale), _CMP_LE_OQ));
+            if (_mm256_movemask_pd(done) == 0xF)
+                break;
+            __m256d dg = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(3.0), m, _mm256_add_pd(A2, A2)), m, A1);
+            __m256d below = _mm256_cmp_pd(g, zero, _CMP_LT_OQ);
+            lo = _mm256_blendv_pd(lo, m, below);
+            hi = _mm256_blendv_pd(m, hi, below);
+            __m256d next = _mm256_sub_pd(m, _mm256_div_pd(g, dg));
+            __m256d inside = _mm256_and_pd(_mm256_cmp_pd(next, lo, _CMP_GT_OQ), _mm256_cmp_pd(next, hi, _CMP_LT_OQ));
+            next = _mm256_blendv_pd(_mm256_mul_pd(half, _mm256_add_pd(lo, hi)), next, inside);
+            m = _mm256_blendv_pd(next, m, done);
+        }
+        __m256d m_min = _mm256_mul_pd(_mm256_set1_pd(1e-12), _mm256_add_pd(one, _mm256_andnot_pd(sign_mask, p)));
+        int fallback = _mm256_movemask_pd(_mm256_andnot_pd(done, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)))) |
+                       _mm256_movemask_pd(_mm256_cmp_pd(m, m_min, _CMP_LE_OQ));
+
+        // the positive roots of (x^2 - s x + h + g)(x^2 + s x + h - g): both of the first quadratic and the
+        // smaller magnitude one of the second, the other one is -(s + sqrt(d2)) / 2 < 0
+        __m256d s = _mm256_sqrt_pd(_mm256_add_pd(m, m));
+        __m256d h = _mm256_fmadd_pd(half, p, m);
+        __m256d g = _mm256_div_pd(_mm256_mul_pd(half, q), s);
+        __m256d s_sq = _mm256_mul_pd(s, s);
+        __m256d c1 = _mm256_add_pd(h, g), c2 = _mm256_sub_pd(h, g);
+        __m256d d1 = _mm256_fnmadd_pd(_mm256_set1_pd(4.0), c1, s_sq);
+        __m256d d2 = _mm256_fnmadd_pd(_mm256_set1_pd(4.0), c2, s_sq);
+        __m256d valid1 = _mm256_cmp_pd(d1, zero, _CMP_GE_OQ), valid2 = _mm256_cmp_pd(d2, zero, _CMP_GE_OQ);
+        __m256d r1 = _mm256_mul_pd(half, _mm256_add_pd(s, _mm256_sqrt_pd(_mm256_max_pd(d1, zero))));
+        __m256d r2 = _mm256_div_pd(c1, r1);
+        __m256d r3 = _mm256_div_pd(c2, _mm256_mul_pd(_mm256_set1_pd(-0.5), _mm256_add_pd(s, _mm256_sqrt_pd(_mm256_max_pd(d2, zero)))));
+
+        __m256d best_T = _mm256_set1_pd(-1.0), best_cost = _mm256_set1_pd(INFINITY);
+        const __m256d candidates[3] = {r1, r2, r3}, candidate_valid[3] = {valid1, valid1, valid2};
+        for (int j = 0; j < 3; ++j)
+        {
+            __m256d x = candidates[j];
+            __m256d valid = _mm256_and_pd(candidate_valid[j], _mm256_cmp_pd(x, T_min, _CMP_GT_OQ));
+            for (int k = 0; k < 2; ++k)
+            {
+                __m256d x_sq = _mm256_mul_pd(x, x);
+                __m256d f = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_add_pd(x_sq, p), x, q), x, r);
+                __m256d df = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(4.0), x_sq, _mm256_add_pd(p, p)), x, q);
+                __m256d step = _mm256_div_pd(f, df);
+                x = _mm256_blendv_pd(_mm256_sub_pd(x, step), x, _mm256_cmp_pd(df, zero, _CMP_EQ_OQ));
+            }
+            valid = _mm256_and_pd(valid, _mm256_cmp_pd(x, T_min, _CMP_GT_OQ));
+            __m256d x_inv = _mm256_div_pd(one, x);
+            __m256d J = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_fmsub_pd(_mm256_mul_pd(_mm256_set1_pd(12.0), c), x_inv, _mm256_mul_pd(_mm256_set1_pd(12.0), b)),
+                                                        x_inv, _mm256_mul_pd(_mm256_set1_pd(4.0), a)),
+                                        x_inv, x);
+            __m256d better = _mm256_and_pd(valid, _mm256_cmp_pd(J, best_cost, _CMP_LT_OQ));
+            best_T = _mm256_blendv_pd(best_T, x, better);
+            best_cost = _mm256_blendv_pd(best_cost, J, better);
+        }
+        _mm256_storeu_pd(T + i, best_T);
+        _mm256_storeu_pd(cost + i, best_cost);
+        for (int l = 0; l < 4; ++l)
+            if (fallback & (1 << l))
+                solveBatchScalar(i + l, i + l + 1, p_x, p_y, p_z, v_x, v_y, v_z, p_f, v_f, T, cost);
+    }
+    return n4;
+}
+#endif
+
+void solveBatch(int n, const double *p_x, const double *p_y, const double *p_z,
+                const double *v_x, const double *v_y, const double *v_z,
+                const Vector3d &p_f, const Vector3d &v_f, double *T, double *cost)
+{
+    int done = 0;
+#ifdef OBVP_AVX2_KERNEL
+    static const bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (has_avx2)
+        done = solveBatchAVX2(n, p_x, p_y, p_z, v_x, v_y, v_z, p_f, v_f, T, cost);
+#endif
+    solveBatchScalar(done, n, p_x, p_y, p_z, v_x, v_y, v_z, p_f, v_f, T, cost);
+}
+
+}
@@ -0,0 +1,74 @@
+#include <primitive_library.h>
+#include <math.h>
+
+using namespace std;
+using namespace Eigen;
+
+void PrimitiveLibrary::init(double _max_input_acc, int _discretize_step, double _time_interval, int _time_step, double _velocity_resolution)
+{
+    max_input_acc       = _max_input_acc;
+    discretize_step     = _discretize_step;
+    time_interval       = _time_interval;
+    time_step           = _time_step;
+    velocity_resolution = _velocity_resolution;
+
+    shapes.clear();
+    hit_num  = 0;
+    miss_num = 0;
+}
+
+Vector3d PrimitiveLibrary::getInput(int i, int j, int k) const
+{
+    Vector3d acc_input;
+    acc_input(0) = double(-max_input_acc + i * (2 * max_input_acc / double(discretize_step)) );
+    acc_input(1) = double(-max_input_acc + j * (2 * max_input_acc / double(discretize_step)) );
+    acc_input(2) = double( k * (2 * max_input_acc / double(discretize_step) ) + 0.1);                          //acc_input_az >0.1
+    return acc_input;
+}
+
+const PrimitiveLibrary::Shapes & PrimitiveLibrary::getShapes(const Vector3d & start_velocity)
+{
+    // 21 bits per axis
+    Vector3i idx = (start_velocity / velocity_resolution).array().round().cast<int>();
+    const int64_t mask = (int64_t(1) << 21) - 1;
+    int64_t key = ((int64_t(idx(0)) & mask) << 42) | ((int64_t(idx(1)) & mask) << 21) | (int64_t(idx(2)) & mask);
+
+    auto it = shapes.find(key);
+    if(it != shapes.end()){
+        ++hit_num;
+        return it->second;
+    }
+    ++miss_num;
+    // the center of the velocity cell, so a cell always holds the same shapes
+    Shapes & result = shapes[key];
+    evaluate(idx.cast<double>() * velocity_resolution, result);
+    return result;
+}
+
+void PrimitiveLibrary::evaluate(const Vector3d & start_velocity, Shapes & result) const
+{
+    int primitive_num = getPrimitiveNum();
+    result.start_velocity = start_velocity;
+    result.end_px.resize(primitive_num);
+    result.end_py.resize(primitive_num);
+    result.end_pz.resize(primitive_num);
+    result.end_vx.resize(primitive_num);
+    result.end_vy.resize(primitive_num);
+    result.end_vz.resize(primitive_num);
+
+    double duration = getDuration();
+    for(int primitive = 0; primitive < primitive_num; primitive++){
+        int i = primitive / ((discretize_step + 1) * (discretize_step + 1));
+        int j = primitive / (discretize_step + 1) % (discretize_step + 1);
+        int k = primitive % (discretize_step + 1);
+        Vector3d acc_input = getInput(i, j, k);
+        Vector3d pos = start_velocity * duration + 0.5 * acc_input * duration * duration;
+        Vector3d vel = start_velocity + acc_input * duration;
+        result.end_px[primitive] = pos(0);
+        result.end_py[primitive] = pos(1);
+        result.end_pz[primitive] = pos(2);
+        result.end_vx[primitive] = vel(0);
+        result.end_vy[primitive] = vel(1);
+        result.end_vz[primitive] = vel(2);
+    }
+}
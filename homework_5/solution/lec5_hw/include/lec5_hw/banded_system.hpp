@@ -0,0 +1,110 @@
+#ifndef BANDED_SYSTEM_HPP
+#define BANDED_SYSTEM_HPP
+
+#include <Eigen/Eigen>
+
+#include <algorithm>
+#include <vector>
+
+// An N x N matrix with lowerBw sub-diagonals and upperBw super-diagonals, stored by diagonals:
+// entry (i, j) is at data[(i - j + upperBw) * N + j]. factorizeLU() does an in-place LU without
+// pivoting, so the system has to be ordered such that no pivot vanishes; the multi-segment
+// polynomial systems are, if every segment's rows are ordered by their leading coefficient.
+// Factorizing takes O(N lowerBw upperBw) and every solve O(N (lowerBw + upperBw)).
+class BandedSystem
+{
+public:
+    BandedSystem() : N(0), lowerBw(0), upperBw(0) {}
+
+    inline void create(const int &n, const int &p, const int &q)
+    {
+        N = n;
+        lowerBw = p;
+        upperBw = q;
+        data.assign((size_t)N * (lowerBw + upperBw + 1), 0.0);
+    }
+
+    inline void reset()
+    {
+        std::fill(data.begin(), data.end(), 0.0);
+    }
+
+    // only entries inside the band may be accessed
+    inline const double &operator()(const int &i, const int &j) const
+    {
+        return data[(size_t)(i - j + upperBw) * N + j];
+    }
+
+    inline double &operator()(const int &i, const int &j)
+    {
+        return data[(size_t)(i - j + upperBw) * N + j];
+    }
+
+    inline void factorizeLU()
+    {
+        for (int k = 0; k < N - 1; k++)
+        {
+            const int iM = std::min(k + lowerBw, N - 1);
+            const double pivot = (*this)(k, k);
+            for (int i = k + 1; i <= iM; i++)
+            {
+                if ((*this)(i, k) != 0.0)
+                {
+                    (*this)(i, k) /= pivot;
+                }
+            }
+            const int jM = std::min(k + upperBw, N - 1);
+            for (int j = k + 1; j <= jM; j++)
+            {
+                const double u = (*this)(k, j);
+                if (u != 0.0)
+                {
+                    for (int i = k + 1; i <= iM; i++)
+                    {
+                        if ((*this)(i, k) != 0.0)
+                        {
+                            (*this)(i, j) -= (*this)(i, k) * u;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // solves in place for every column of b, after factorizeLU()
+    template <typename Derived>
+    inline void solve(Eigen::MatrixBase<Derived> &b) const
+    {
+        for (int j = 0; j < N; j++)
+        {
+            const int iM = std::min(j + lowerBw, N - 1);
+            for (int i = j + 1; i <= iM; i++)
+            {
+                if ((*this)(i, j) != 0.0)
+                {
+                    b.row(i) -= (*this)(i, j) * b.row(j);
+                }
+            }
+        }
+        for (int j = N - 1; j >= 0; j--)
+        {
+            b.row(j) /= (*this)(j, j);
+            const int iM = std::max(0, j - upperBw);
+            for (int i = iM; i < j; i++)
+            {
+                if ((*this)(i, j) != 0.0)
+                {
+                    b.row(i) -= (*this)(i, j) * b.row(j);
+                }
+            }
+        }
+    }
+
+private:
+    int N;
+    int lowerBw;
+    int upperBw;
+    std::vector<double> data;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef MIN_JERK_HPP
+#define MIN_JERK_HPP
+
+#include "lec5_hw/banded_system.hpp"
+#include "scope_trace/scope_trace.hpp"
+
+#include <Eigen/Eigen>
+
+inline void minimumJerkTrajGen(
+    // Inputs:
+    const int pieceNum,
+    const Eigen::Vector3d &initialPos,
+    const Eigen::Vector3d &initialVel,
+    const Eigen::Vector3d &initialAcc,
+    const Eigen::Vector3d &terminalPos,
+    const Eigen::Vector3d &terminalVel,
+    const Eigen::Vector3d &terminalAcc,
+    const Eigen::Matrix3Xd &intermediatePositions,
+    const Eigen::VectorXd &timeAllocationVector,
+    // Outputs:
+    Eigen::MatrixX3d &coefficientMatrix)
+{
+    SCOPE_TRACE_FUNCTION();
+    // coefficientMatrix is a matrix with 6*piece num rows and 3 columes
+    // As for a polynomial c0+c1*t+c2*t^2+c3*t^3+c4*t^4+c5*t^5,
+    // each 6*3 sub-block of coefficientMatrix is
+    // --              --
+    // | c0_x c0_y c0_z |
+    // | c1_x c1_y c1_z |
+    // | c2_x c2_y c2_z |
+    // | c3_x c3_y c3_z |
+    // | c4_x c4_y c4_z |
+    // | c5_x c5_y c5_z |
+    // --              --
+    // The constraints couple a piece only with its neighbours, so M is banded with 6 sub- and
+    // super-diagonals and is solved by a banded LU in O(pieceNum). At every waypoint the jerk and
+    // snap continuity rows come before the position rows, which keeps the pivots of the LU without
+    // pivoting away from zero.
+
+    BandedSystem M;
+    M.create(6 * pieceNum, 6, 6);
+    Eigen::MatrixX3d &B = coefficientMatrix;
+    B.setZero(6 * pieceNum, 3);
+
+    // initial p,v,a constraint
+    M(0, 0) = 1.0;
+    M(1, 1) = 1.0;
+    M(2, 2) = 2.0;
+    B.row(0) = initialPos.transpose();
+    B.row(1) = initialVel.transpose();
+    B.row(2) = initialAcc.transpose();
+
+    for (int i = 0; i < pieceNum - 1; i++)
+    {
+        const double t1 = timeAllocationVector(i);
+        const double t2 = t1 * t1;
+        const double t3 = t2 * t1;
+        const double t4 = t2 * t2;
+        const double t5 = t4 * t1;
+
+        // jerk continuity constraint
+        M(6 * i + 3, 6 * i + 3) = 6.0;
+        M(6 * i + 3, 6 * i + 4) = 24.0 * t1;
+        M(6 * i + 3, 6 * i + 5) = 60.0 * t2;
+        M(6 * i + 3, 6 * i + 9) = -6.0;
+
+        // snap continuity constraint
+        M(6 * i + 4, 6 * i + 4) = 24.0;
+        M(6 * i + 4, 6 * i + 5) = 120.0 * t1;
+        M(6 * i + 4, 6 * i + 10) = -24.0;
+
+        // position constaint
+        M(6 * i + 5, 6 * i) = 1.0;
+        M(6 * i + 5, 6 * i + 1) = t1;
+        M(6 * i + 5, 6 * i + 2) = t2;
+        M(6 * i + 5, 6 * i + 3) = t3;
+        M(6 * i + 5, 6 * i + 4) = t4;
+        M(6 * i + 5, 6 * i + 5) = t5;
+        B.row(6 * i + 5) = intermediatePositions.col(i).transpose();
+
+        // position continuity constraint
+        M(6 * i + 6, 6 * i) = 1.0;
+        M(6 * i + 6, 6 * i + 1) = t1;
+        M(6 * i + 6, 6 * i + 2) = t2;
+        M(6 * i + 6, 6 * i + 3) = t3;
+        M(6 * i + 6, 6 * i + 4) = t4;
+        M(6 * i + 6, 6 * i + 5) = t5;
+        M(6 * i + 6, 6 * i + 6) = -1.0;
+
+        // velocity continuity constraint
+        M(6 * i + 7, 6 * i + 1) = 1.0;
+        M(6 * i + 7, 6 * i + 2) = 2.0 * t1;
+        M(6 * i + 7, 6 * i + 3) = 3.0 * t2;
+        M(6 * i + 7, 6 * i + 4) = 4.0 * t3;
+        M(6 * i + 7, 6 * i + 5) = 5.0 * t4;
+        M(6 * i + 7, 6 * i + 7) = -1.0;
+
+        // acceleration continuity constraint
+        M(6 * i + 8, 6 * i + 2) = 2.0;
+        M(6 * i + 8, 6 * i + 3) = 6.0 * t1;
+        M(6 * i + 8, 6 * i + 4) = 12.0 * t2;
+        M(6 * i + 8, 6 * i + 5) = 20.0 * t3;
+        M(6 * i + 8, 6 * i + 8) = -2.0;
+    }
+
+    // terminal p,v,a constraint
+    const int k = 6 * (pieceNum - 1);
+    const double t1 = timeAllocationVector(pieceNum - 1);
+    const double t2 = t1 * t1;
+    const double t3 = t2 * t1;
+    const double t4 = t2 * t2;
+    const double t5 = t4 * t1;
+    M(k + 3, k) = 1.0;
+    M(k + 3, k + 1) = t1;
+    M(k + 3, k + 2) = t2;
+    M(k + 3, k + 3) = t3;
+    M(k + 3, k + 4) = t4;
+    M(k + 3, k + 5) = t5;
+    M(k + 4, k + 1) = 1.0;
+    M(k + 4, k + 2) = 2.0 * t1;
+    M(k + 4, k + 3) = 3.0 * t2;
+    M(k + 4, k + 4) = 4.0 * t3;
+    M(k + 4, k + 5) = 5.0 * t4;
+    M(k + 5, k + 2) = 2.0;
+    M(k + 5, k + 3) = 6.0 * t1;
+    M(k + 5, k + 4) = 12.0 * t2;
+    M(k + 5, k + 5) = 20.0 * t3;
+    B.row(k + 3) = terminalPos.transpose();
+    B.row(k + 4) = terminalVel.transpose();
+    B.row(k + 5) = terminalAcc.transpose();
+
+    M.factorizeLU();
+    M.solve(B);
+}
+
+#endif
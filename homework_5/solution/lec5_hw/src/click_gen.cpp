@@ -1,5 +1,7 @@
 #include "lec5_hw/visualizer.hpp"
 #include "lec5_hw/trajectory.hpp"
+#include "lec5_hw/min_jerk.hpp"
+#include "scope_trace/scope_trace.hpp"
 
 #include <ros/ros.h>
 #include <geometry_msgs/Point.h>
@@ -20,6 +22,8 @@ struct Config
     double allocationSpeed;
     double allocationAcc;
     int maxPieceNum;
+    bool traceEnable;
+    std::string traceOutput;
 
     Config(const ros::NodeHandle &nh_priv)
     {
@@ -32,6 +36,8 @@ struct Config
         nh_priv.getParam("AllocationSpeed", allocationSpeed);
         nh_priv.getParam("AllocationAcc", allocationAcc);
         nh_priv.getParam("MaxPieceNum", maxPieceNum);
+        nh_priv.param("TraceEnable", traceEnable, false);
+        nh_priv.param("TraceOutput", traceOutput, std::string("/tmp/click_gen_trace.json"));
     }
 };
 
@@ -52,121 +58,6 @@ double timeTrapzVel(const double dist,
     }
 }
 
-void minimumJerkTrajGen(
-    // Inputs:
-    const int pieceNum,
-    const Eigen::Vector3d &initialPos,
-    const Eigen::Vector3d &initialVel,
-    const Eigen::Vector3d &initialAcc,
-    const Eigen::Vector3d &terminalPos,
-    const Eigen::Vector3d &terminalVel,
-    const Eigen::Vector3d &terminalAcc,
-    const Eigen::Matrix3Xd &intermediatePositions,
-    const Eigen::VectorXd &timeAllocationVector,
-    // Outputs:
-    Eigen::MatrixX3d &coefficientMatrix)
-{
-    // coefficientMatrix is a matrix with 6*piece num rows and 3 columes
-    // As for a polynomial c0+c1*t+c2*t^2+c3*t^3+c4*t^4+c5*t^5,
-    // each 6*3 sub-block of coefficientMatrix is
-    // --              --
-    // | c0_x c0_y c0_z |
-    // | c1_x c1_y c1_z |
-    // | c2_x c2_y c2_z |
-    // | c3_x c3_y c3_z |
-    // | c4_x c4_y c4_z |
-    // | c5_x c5_y c5_z |
-    // --              --
-    // Please computed coefficientMatrix of the minimum-jerk trajectory
-    // in this function
-
-    // ------------------------ Put your solution below ------------------------
-
-    Eigen::MatrixXd M = Eigen::MatrixXd::Zero(6 * pieceNum, 6 * pieceNum);
-    Eigen::MatrixX3d B = Eigen::MatrixXd::Zero(6 * pieceNum, 3);
-
-    // initial p,v,a constraint
-    M(0, 0) = 1.0;
-    M(1, 1) = 1.0;
-    M(2, 2) = 2.0;
-    B.row(0) = initialPos.transpose();
-    B.row(1) = initialVel.transpose();
-    B.row(2) = initialAcc.transpose();
-
-
-    for (int i = 0; i < pieceNum - 1; i++) {
-        
-        B.row(6 * i + 3) = intermediatePositions.col(i).transpose();
-
-        // position constaint  
-        M(6 * i + 3, 6 * i) = 1.0;
-        M(6 * i + 3, 6 * i + 1) = timeAllocationVector(i);
-        M(6 * i + 3, 6 * i + 2) = std::pow(timeAllocationVector(i), 2);
-        M(6 * i + 3, 6 * i + 3) = std::pow(timeAllocationVector(i), 3);
-        M(6 * i + 3, 6 * i + 4) = std::pow(timeAllocationVector(i), 4);
-        M(6 * i + 3, 6 * i + 5) = std::pow(timeAllocationVector(i), 5);
-
-        // position continuity constraint
-        M(6 * i + 4, 6 * i) = 1.0;
-        M(6 * i + 4, 6 * i + 1) = timeAllocationVector(i);
-        M(6 * i + 4, 6 * i + 2) = std::pow(timeAllocationVector(i), 2);
-        M(6 * i + 4, 6 * i + 3) = std::pow(timeAllocationVector(i), 3);
-        M(6 * i + 4, 6 * i + 4) = std::pow(timeAllocationVector(i), 4);
-        M(6 * i + 4, 6 * i + 5) = std::pow(timeAllocationVector(i), 5);
-        M(6 * i + 4, 6 * i + 6) = -1.0;
-
-        // velocity continuity constraint
-        M(6 * i + 5, 6 * i + 1) = 1.0;
-        M(6 * i + 5, 6 * i + 2) = 2 * timeAllocationVector(i);
-        M(6 * i + 5, 6 * i + 3) = 3 * std::pow(timeAllocationVector(i), 2);
-        M(6 * i + 5, 6 * i + 4) = 4 * std::pow(timeAllocationVector(i), 3);
-        M(6 * i + 5, 6 * i + 5) = 5 * std::pow(timeAllocationVector(i), 4);
-        M(6 * i + 5, 6 * i + 7) = -1.0;
-
-        // acceleration continuity constraint
-        M(6 * i + 6, 6 * i + 2) = 2.0;
-        M(6 * i + 6, 6 * i + 3) = 6 * timeAllocationVector(i);
-        M(6 * i + 6, 6 * i + 4) = 12 * std::pow(timeAllocationVector(i), 2);
-        M(6 * i + 6, 6 * i + 5) = 20 * std::pow(timeAllocationVector(i), 3);
-        M(6 * i + 6, 6 * i + 8) = -2.0;
-
-         // jerk continuity constraint
-        M(6 * i + 7, 6 * i + 3) = 6.0;
-        M(6 * i + 7, 6 * i + 4) = 24.0 * timeAllocationVector(i);
-        M(6 * i + 7, 6 * i + 5) = 60.0 * std::pow(timeAllocationVector(i), 2);
-        M(6 * i + 7, 6 * i + 9) = -6.0;
-
-        // snap continuity constraint
-        M(6 * i + 8, 6 * i + 4) = 24.0;
-        M(6 * i + 8, 6 * i + 5) = 120.0 * timeAllocationVector(i);
-        M(6 * i + 8, 6 * i + 10) = -24.0;
-    }
-
-    M(6 * pieceNum - 3, 6 * pieceNum - 6) = 1.0;
-    M(6 * pieceNum - 3, 6 * pieceNum - 5) = timeAllocationVector(pieceNum - 1);
-    M(6 * pieceNum - 3, 6 * pieceNum - 4) = std::pow(timeAllocationVector(pieceNum - 1), 2);
-    M(6 * pieceNum - 3, 6 * pieceNum - 3) = std::pow(timeAllocationVector(pieceNum - 1), 3);
-    M(6 * pieceNum - 3, 6 * pieceNum - 2) = std::pow(timeAllocationVector(pieceNum - 1), 4);
-    M(6 * pieceNum - 3, 6 * pieceNum - 1) = std::pow(timeAllocationVector(pieceNum - 1), 5);
-    M(6 * pieceNum - 2, 6 * pieceNum - 5) = 1.0;
-    M(6 * pieceNum - 2, 6 * pieceNum - 4) = 2 * timeAllocationVector(pieceNum - 1);
-    M(6 * pieceNum - 2, 6 * pieceNum - 3) = 3 * std::pow(timeAllocationVector(pieceNum - 1), 2);
-    M(6 * pieceNum - 2, 6 * pieceNum - 2) = 4 * std::pow(timeAllocationVector(pieceNum - 1), 3);
-    M(6 * pieceNum - 2, 6 * pieceNum - 1) = 5 * std::pow(timeAllocationVector(pieceNum - 1), 4);
-    M(6 * pieceNum - 1, 6 * pieceNum - 4) = 2;
-    M(6 * pieceNum - 1, 6 * pieceNum - 3) = 6 * timeAllocationVector(pieceNum - 1);
-    M(6 * pieceNum - 1, 6 * pieceNum - 2) = 12 * std::pow(timeAllocationVector(pieceNum - 1), 2);
-    M(6 * pieceNum - 1, 6 * pieceNum - 1) = 20 * std::pow(timeAllocationVector(pieceNum - 1), 3);
-
-    B.row(6 * pieceNum - 3) = terminalPos.transpose();
-    B.row(6 * pieceNum - 2) = terminalVel.transpose();
-    B.row(6 * pieceNum - 1) = terminalAcc.transpose();
-
-    
-    coefficientMatrix =  M.inverse() * B;
-    // ------------------------ Put your solution above ------------------------
-}
-
 class ClickGen
 {
 private:
@@ -199,6 +90,7 @@ public:
 
     void targetCallBack(const geometry_msgs::PoseStamped::ConstPtr &msg)
     {
+        SCOPE_TRACE_ZONE("targetCallBack");
         if (positionNum > config.maxPieceNum)
         {
             positionNum = 0;
@@ -258,7 +150,13 @@ int main(int argc, char **argv)
 {
     ros::init(argc, argv, "click_gen_node");
     ros::NodeHandle nh_;
-    ClickGen clickGen(Config(ros::NodeHandle("~")), nh_);
+    Config config(ros::NodeHandle("~"));
+    scope_trace::setEnabled(config.traceEnable);
+    ClickGen clickGen(config, nh_);
     ros::spin();
+    if (config.traceEnable && scope_trace::dump(config.traceOutput))
+    {
+        ROS_INFO("[click_gen] trace written to %s", config.traceOutput.c_str());
+    }
     return 0;
 }
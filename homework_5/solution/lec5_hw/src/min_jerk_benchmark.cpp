@@ -0,0 +1,265 @@
+#include "lec5_hw/min_jerk.hpp"
+
+#include <Eigen/Eigen>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+/*
+    Scaling benchmark of minimumJerkTrajGen over the number of pieces, for several ranges of piece
+    durations. Up to the timing limit it is timed against the dense M.inverse() * B solve it replaced,
+    up to the reference limit the coefficients are compared against a pivoted LU of the same dense
+    system, and for every size the solution is checked against its own constraints: waypoints,
+    boundary states and the continuity of the derivatives up to snap at every waypoint.
+
+    rosrun lec5_hw min_jerk_benchmark [max_piece_num] [seed]
+
+    Exits with 1 if any check fails.
+*/
+
+struct Problem
+{
+    Eigen::Vector3d initialPos, initialVel, initialAcc;
+    Eigen::Vector3d terminalPos, terminalVel, terminalAcc;
+    Eigen::Matrix3Xd intermediatePositions;
+    Eigen::VectorXd times;
+};
+
+// durations are drawn log-uniformly from [minDur, maxDur]
+static Problem randomProblem(const int pieceNum, const double minDur, const double maxDur, std::mt19937 &gen)
+{
+    std::uniform_real_distribution<double> step(-2.0, 2.0), state(-1.0, 1.0);
+    std::uniform_real_distribution<double> logDur(std::log(minDur), std::log(maxDur));
+    Problem pb;
+    pb.initialPos.setZero();
+    pb.initialVel << state(gen), state(gen), state(gen);
+    pb.initialAcc << state(gen), state(gen), state(gen);
+    pb.intermediatePositions.resize(3, pieceNum - 1);
+    Eigen::Vector3d p = pb.initialPos;
+    for (int i = 0; i < pieceNum - 1; i++)
+    {
+        p += Eigen::Vector3d(step(gen), step(gen), step(gen));
+        pb.intermediatePositions.col(i) = p;
+    }
+    pb.terminalPos = p + Eigen::Vector3d(step(gen), step(gen), step(gen));
+    pb.terminalVel << state(gen), state(gen), state(gen);
+    pb.terminalAcc << state(gen), state(gen), state(gen);
+    pb.times.resize(pieceNum);
+    for (int i = 0; i < pieceNum; i++)
+    {
+        pb.times(i) = std::exp(logDur(gen));
+    }
+    return pb;
+}
+
+static void solveBanded(const Problem &pb, Eigen::MatrixX3d &coeff)
+{
+    minimumJerkTrajGen(pb.times.size(), pb.initialPos, pb.initialVel, pb.initialAcc,
+                       pb.terminalPos, pb.terminalVel, pb.terminalAcc,
+                       pb.intermediatePositions, pb.times, coeff);
+}
+
+// the dense system with the former row order
+static void denseSystem(const Problem &pb, Eigen::MatrixXd &M, Eigen::MatrixX3d &B)
+{
+    const int N = pb.times.size();
+    M = Eigen::MatrixXd::Zero(6 * N, 6 * N);
+    B = Eigen::MatrixXd::Zero(6 * N, 3);
+    M(0, 0) = 1.0;
+    M(1, 1) = 1.0;
+    M(2, 2) = 2.0;
+    B.row(0) = pb.initialPos.transpose();
+    B.row(1) = pb.initialVel.transpose();
+    B.row(2) = pb.initialAcc.transpose();
+    for (int i = 0; i < N - 1; i++)
+    {
+        const double T = pb.times(i);
+        B.row(6 * i + 3) = pb.intermediatePositions.col(i).transpose();
+        for (int j = 0; j < 6; j++)
+        {
+            M(6 * i + 3, 6 * i + j) = std::pow(T, j);
+            M(6 * i + 4, 6 * i + j) = std::pow(T, j);
+        }
+        M(6 * i + 4, 6 * i + 6) = -1.0;
+        for (int j = 1; j < 6; j++)
+        {
+            M(6 * i + 5, 6 * i + j) = j * std::pow(T, j - 1);
+        }
+        M(6 * i + 5, 6 * i + 7) = -1.0;
+        for (int j = 2; j < 6; j++)
+        {
+            M(6 * i + 6, 6 * i + j) = j * (j - 1) * std::pow(T, j - 2);
+        }
+        M(6 * i + 6, 6 * i + 8) = -2.0;
+        for (int j = 3; j < 6; j++)
+        {
+            M(6 * i + 7, 6 * i + j) = j * (j - 1) * (j - 2) * std::pow(T, j - 3);
+        }
+        M(6 * i + 7, 6 * i + 9) = -6.0;
+        for (int j = 4; j < 6; j++)
+        {
+            M(6 * i + 8, 6 * i + j) = j * (j - 1) * (j - 2) * (j - 3) * std::pow(T, j - 4);
+        }
+        M(6 * i + 8, 6 * i + 10) = -24.0;
+    }
+    const double T = pb.times(N - 1);
+    for (int j = 0; j < 6; j++)
+    {
+        M(6 * N - 3, 6 * N - 6 + j) = std::pow(T, j);
+    }
+    for (int j = 1; j < 6; j++)
+    {
+        M(6 * N - 2, 6 * N - 6 + j) = j * std::pow(T, j - 1);
+    }
+    for (int j = 2; j < 6; j++)
+    {
+        M(6 * N - 1, 6 * N - 6 + j) = j * (j - 1) * std::pow(T, j - 2);
+    }
+    B.row(6 * N - 3) = pb.terminalPos.transpose();
+    B.row(6 * N - 2) = pb.terminalVel.transpose();
+    B.row(6 * N - 1) = pb.terminalAcc.transpose();
+}
+
+// the former solve, for timing
+static void solveDense(const Problem &pb, Eigen::MatrixX3d &coeff)
+{
+    Eigen::MatrixXd M;
+    Eigen::MatrixX3d B;
+    denseSystem(pb, M, B);
+    coeff = M.inverse() * B;
+}
+
+// reference coefficients, from a partial pivoting LU that is cheaper and more accurate than the inverse
+static void solveReference(const Problem &pb, Eigen::MatrixX3d &coeff)
+{
+    Eigen::MatrixXd M;
+    Eigen::MatrixX3d B;
+    denseSystem(pb, M, B);
+    coeff = M.partialPivLu().solve(B);
+}
+
+// the d-th derivative of piece i at time t, and the magnitude of the terms it sums
+static Eigen::Vector3d derivative(const Eigen::MatrixX3d &coeff, const int i, const int d, const double t,
+                                  Eigen::Vector3d &magnitude)
+{
+    Eigen::Vector3d value = Eigen::Vector3d::Zero();
+    magnitude.setZero();
+    for (int j = 5; j >= d; j--)
+    {
+        double factor = 1.0;
+        for (int l = 0; l < d; l++)
+        {
+            factor *= j - l;
+        }
+        value = value * t + factor * coeff.row(6 * i + j).transpose();
+        magnitude = magnitude * std::fabs(t) + factor * coeff.row(6 * i + j).transpose().cwiseAbs();
+    }
+    return value;
+}
+
+// largest constraint violation, each relative to the magnitude of the terms it is computed from;
+// short pieces have large coefficients whose rounding no solver can avoid
+static double constraintError(const Problem &pb, const Eigen::MatrixX3d &coeff)
+{
+    const int N = pb.times.size();
+    double err = 0.0;
+    Eigen::Vector3d magA, magB;
+    auto check = [&](const Eigen::Vector3d &a, const Eigen::Vector3d &b) {
+        const Eigen::Vector3d scale = magA.cwiseMax(magB).cwiseMax(b.cwiseAbs()).cwiseMax(1.0);
+        err = std::max(err, ((a - b).cwiseAbs().array() / scale.array()).maxCoeff());
+    };
+    magB.setZero();
+    check(derivative(coeff, 0, 0, 0.0, magA), pb.initialPos);
+    check(derivative(coeff, 0, 1, 0.0, magA), pb.initialVel);
+    check(derivative(coeff, 0, 2, 0.0, magA), pb.initialAcc);
+    for (int i = 0; i < N - 1; i++)
+    {
+        magB.setZero();
+        check(derivative(coeff, i, 0, pb.times(i), magA), pb.intermediatePositions.col(i));
+        for (int d = 0; d < 5; d++)
+        {
+            const Eigen::Vector3d b = derivative(coeff, i + 1, d, 0.0, magB);
+            check(derivative(coeff, i, d, pb.times(i), magA), b);
+        }
+    }
+    magB.setZero();
+    check(derivative(coeff, N - 1, 0, pb.times(N - 1), magA), pb.terminalPos);
+    check(derivative(coeff, N - 1, 1, pb.times(N - 1), magA), pb.terminalVel);
+    check(derivative(coeff, N - 1, 2, pb.times(N - 1), magA), pb.terminalAcc);
+    return err;
+}
+
+template <typename F>
+static double timeUs(F f)
+{
+    // repeat short solves for about 20 ms
+    int reps = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do
+    {
+        f();
+        reps++;
+        elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    } while (elapsed < 2e4);
+    return elapsed / reps;
+}
+
+int main(int argc, char **argv)
+{
+    const int maxPieceNum = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const int seed = argc > 2 ? std::atoi(argv[2]) : 0;
+    const int timingLimit = 100;
+    const int referenceLimit = 500;
+    // Short, medium and long pieces, and all of them mixed in one trajectory. Mixing durations
+    // makes the system ill-conditioned: the pivoted reference then violates the constraints by up
+    // to about 1e-9 as well, so the mixed range only gets a bound that catches a broken solve.
+    const int rangeNum = 4;
+    const double durations[rangeNum][2] = {{0.01, 0.1}, {0.5, 2.0}, {5.0, 20.0}, {0.01, 20.0}};
+    const double tols[rangeNum] = {1e-12, 1e-12, 1e-12, 1e-6};
+
+    std::mt19937 gen(seed);
+    bool ok = true;
+    printf("%15s %8s %14s %14s %12s %12s %12s\n", "durations [s]", "pieces", "banded [us]", "dense [us]", "diff",
+           "violation", "ref. viol.");
+    for (int r = 0; r < rangeNum; r++)
+    {
+        char range[32];
+        snprintf(range, sizeof(range), "%g-%g", durations[r][0], durations[r][1]);
+        for (int pieceNum = 1; pieceNum <= maxPieceNum; pieceNum *= 10)
+        {
+            const int sizes[2] = {pieceNum, 5 * pieceNum};
+            for (int s = 0; s < 2 && sizes[s] <= maxPieceNum; s++)
+            {
+                const int N = sizes[s];
+                const Problem pb = randomProblem(N, durations[r][0], durations[r][1], gen);
+                Eigen::MatrixX3d banded, dense, reference;
+                const double bandedUs = timeUs([&]() { solveBanded(pb, banded); });
+                const double violation = constraintError(pb, banded);
+                ok = ok && violation < tols[r];
+                char denseUs[16] = "-", diff[16] = "-", refViolation[16] = "-";
+                if (N <= timingLimit)
+                {
+                    snprintf(denseUs, sizeof(denseUs), "%.2f", timeUs([&]() { solveDense(pb, dense); }));
+                }
+                if (N <= referenceLimit)
+                {
+                    solveReference(pb, reference);
+                    const double d = (banded - reference).lpNorm<Eigen::Infinity>() /
+                                     std::max(1.0, reference.lpNorm<Eigen::Infinity>());
+                    ok = ok && d < tols[r];
+                    snprintf(diff, sizeof(diff), "%.2e", d);
+                    snprintf(refViolation, sizeof(refViolation), "%.2e", constraintError(pb, reference));
+                }
+                printf("%15s %8d %14.2f %14s %12s %12.2e %12s\n", range, N, bandedUs, denseUs, diff, violation,
+                       refViolation);
+            }
+        }
+    }
+    printf(ok ? "all checks passed\n" : "CHECK FAILED\n");
+    return ok ? 0 : 1;
+}
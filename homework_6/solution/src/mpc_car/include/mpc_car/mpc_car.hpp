@@ -6,6 +6,7 @@
 #include <arc_spline/arc_spline.hpp>
 #include <deque>
 #include <iosqp/iosqp.hpp>
+#include <scope_trace/scope_trace.hpp>
 
 namespace mpc_car {
 
@@ -249,6 +250,7 @@ class MpcCar {
   }
 
   int solveQP(const VectorX& x0_observe) {
+    SCOPE_TRACE_FUNCTION();
     x0_observe_ = x0_observe;
     historyInput_.pop_front();
     historyInput_.push_back(predictInput_.front());
@@ -356,6 +358,7 @@ class MpcCar {
     P_ = BBT_sparse * Qx_ * BB_sparse;
     q_ = BBT_sparse * Qx_.transpose() * (AA_sparse * x0_sparse + gg_sparse) + BBT_sparse * qx;
     // osqp
+    SCOPE_TRACE_ZONE("osqp");
     Eigen::VectorXd q_d = q_.toDense();
     Eigen::VectorXd l_d = l_.toDense();
     Eigen::VectorXd u_d = u_.toDense();
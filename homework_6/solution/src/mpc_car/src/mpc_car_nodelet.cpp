@@ -5,6 +5,7 @@
 
 #include <Eigen/Geometry>
 #include <mpc_car/mpc_car.hpp>
+#include <scope_trace/scope_trace.hpp>
 
 namespace mpc_car {
 class Nodelet : public nodelet::Nodelet {
@@ -16,9 +17,12 @@ class Nodelet : public nodelet::Nodelet {
   VectorX state_;
   bool init = false;
   double delay_ = 0.0;
+  bool trace_enable_ = false;
+  std::string trace_output_;
 
   void plan_timer_callback(const ros::TimerEvent& event) {
     if (init) {
+      SCOPE_TRACE_ZONE("plan_timer_callback");
       ros::Time t1 = ros::Time::now();
       auto ret = mpcPtr_->solveQP(state_);
       assert(ret == 1);
@@ -39,6 +43,7 @@ class Nodelet : public nodelet::Nodelet {
       msg.a = u(0);
       msg.delta = u(1);
       cmd_pub_.publish(msg);
+      SCOPE_TRACE_ZONE("visualization");
       mpcPtr_->visualization();
     }
     return;
@@ -57,12 +62,20 @@ class Nodelet : public nodelet::Nodelet {
   }
 
  public:
+  ~Nodelet() {
+    if (trace_enable_ && scope_trace::dump(trace_output_)) {
+      ROS_INFO("[mpc_car] trace written to %s", trace_output_.c_str());
+    }
+  }
   void onInit(void) {
     ros::NodeHandle nh(getMTPrivateNodeHandle());
     mpcPtr_ = std::make_shared<MpcCar>(nh);
     double dt = 0;
     nh.getParam("dt", dt);
     nh.getParam("delay", delay_);
+    nh.param("trace_enable", trace_enable_, false);
+    nh.param("trace_output", trace_output_, std::string("/tmp/mpc_car_trace.json"));
+    scope_trace::setEnabled(trace_enable_);
 
     plan_timer_ = nh.createTimer(ros::Duration(dt), &Nodelet::plan_timer_callback, this);
     odom_sub_ = nh.subscribe<nav_msgs::Odometry>("odom", 1, &Nodelet::odom_call_back, this);